@@ -0,0 +1,404 @@
+// fms_adjoint.h - Reverse mode automatic differentiation
+// Each operation on a var records a node on the active tape holding the indices
+// of its arguments and the partial derivatives with respect to them.
+// A backward sweep from the result then gives the derivative with respect to
+// every recorded variable in time proportional to the number of nodes.
+//
+//	auto& t = adjoint::tape::active();
+//	t.clear();
+//	var f = var::variable(100), s = var::variable(0.2);
+//	var v = option::black::value(N, f, s, var(110));
+//	t.backward(v.i);
+//	double delta = f.adjoint(), vega = s.adjoint();
+//
+// Nodes live in an arena of fixed size blocks that clear() keeps, so recording
+// does not allocate once the tape has grown to the size of the calculation.
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "fms_variate.h"
+
+namespace fms::adjoint {
+
+	// Bump allocator of T in blocks of N. Elements are not destroyed until the arena is.
+	template<class T, size_t N = 4096>
+	class arena {
+		std::vector<std::unique_ptr<T[]>> block;
+		size_t n;
+		T* p; // next free element in current block
+		T* e; // end of current block
+	public:
+		arena()
+			: n(0), p(nullptr), e(nullptr)
+		{ }
+		arena(const arena&) = delete;
+		arena& operator=(const arena&) = delete;
+		~arena()
+		{ }
+
+		// number of elements in use
+		size_t size() const
+		{
+			return n;
+		}
+		// number of elements allocated
+		size_t capacity() const
+		{
+			return block.size() * N;
+		}
+
+		T& operator[](size_t i)
+		{
+			return block[i / N][i % N];
+		}
+		const T& operator[](size_t i) const
+		{
+			return block[i / N][i % N];
+		}
+
+		// append t and return its index
+		size_t push_back(const T& t)
+		{
+			if (p == e) {
+				if (n == capacity()) {
+					block.emplace_back(std::make_unique<T[]>(N));
+				}
+				p = block[n / N].get();
+				e = p + N;
+			}
+			*p++ = t;
+
+			return n++;
+		}
+
+		// reuse all blocks
+		void clear()
+		{
+			n = 0;
+			p = e = nullptr;
+		}
+	};
+
+	// index of no node
+	inline constexpr size_t none = std::numeric_limits<size_t>::max();
+
+	// result of an operation with up to two arguments
+	struct node {
+		size_t i[2]; // argument indices or none
+		double d[2]; // partial derivatives with respect to arguments
+	};
+
+	class tape {
+		arena<node> nodes;
+		std::vector<double> a; // adjoints after backward
+	public:
+		tape()
+		{ }
+		tape(const tape&) = delete;
+		tape& operator=(const tape&) = delete;
+		~tape()
+		{ }
+
+		// tape used by var on this thread
+		static tape& active()
+		{
+			thread_local tape t;
+
+			return t;
+		}
+
+		size_t size() const
+		{
+			return nodes.size();
+		}
+
+		// record a node and return its index
+		size_t push_back(size_t i0, double d0, size_t i1 = none, double d1 = 0)
+		{
+			return nodes.push_back(node{ { i0, i1 }, { d0, d1 } });
+		}
+
+		// forget all nodes but keep memory
+		void clear()
+		{
+			nodes.clear();
+			a.clear();
+		}
+
+		// a[j] = dy/dx_j for every node j recorded before y
+		void backward(size_t y)
+		{
+			a.assign(nodes.size(), 0);
+			if (y == none) {
+				return;
+			}
+
+			a[y] = 1;
+			for (size_t j = y + 1; j-- > 0; ) {
+				double aj = a[j];
+				if (aj == 0) {
+					continue;
+				}
+
+				const node& n = nodes[j];
+				if (n.i[0] != none) {
+					a[n.i[0]] += n.d[0] * aj;
+				}
+				if (n.i[1] != none) {
+					a[n.i[1]] += n.d[1] * aj;
+				}
+			}
+		}
+
+		// adjoint of node j after backward
+		double adjoint(size_t j) const
+		{
+			return j < a.size() ? a[j] : 0;
+		}
+	};
+
+	// Value and index on the active tape. Constants have index none and are not recorded.
+	struct var {
+		double x;
+		size_t i;
+
+		constexpr var(double x = 0)
+			: x(x), i(none)
+		{ }
+		constexpr var(double x, size_t i)
+			: x(x), i(i)
+		{ }
+
+		// independent variable
+		static var variable(double x)
+		{
+			return var(x, tape::active().push_back(none, 0));
+		}
+
+		// y = f(a) with f'(a) = da
+		static var record(double y, const var& a, double da)
+		{
+			return a.i == none ? var(y) : var(y, tape::active().push_back(a.i, da));
+		}
+		// y = f(a, b) with partials da and db
+		static var record(double y, const var& a, double da, const var& b, double db)
+		{
+			if (a.i == none) {
+				return record(y, b, db);
+			}
+			if (b.i == none) {
+				return record(y, a, da);
+			}
+
+			return var(y, tape::active().push_back(a.i, da, b.i, db));
+		}
+
+		// dy/dx after tape::backward(y)
+		double adjoint() const
+		{
+			return i == none ? 0 : tape::active().adjoint(i);
+		}
+
+		var operator-() const
+		{
+			return record(-x, *this, -1);
+		}
+		var operator+() const
+		{
+			return *this;
+		}
+
+		friend var operator+(const var& a, const var& b)
+		{
+			return record(a.x + b.x, a, 1, b, 1);
+		}
+		friend var operator-(const var& a, const var& b)
+		{
+			return record(a.x - b.x, a, 1, b, -1);
+		}
+		friend var operator*(const var& a, const var& b)
+		{
+			return record(a.x * b.x, a, b.x, b, a.x);
+		}
+		friend var operator/(const var& a, const var& b)
+		{
+			double y = a.x / b.x;
+
+			return record(y, a, 1 / b.x, b, -y / b.x);
+		}
+
+		var& operator+=(const var& b)
+		{
+			return *this = *this + b;
+		}
+		var& operator-=(const var& b)
+		{
+			return *this = *this - b;
+		}
+		var& operator*=(const var& b)
+		{
+			return *this = *this * b;
+		}
+		var& operator/=(const var& b)
+		{
+			return *this = *this / b;
+		}
+
+		// compare values
+		friend bool operator==(const var& a, const var& b)
+		{
+			return a.x == b.x;
+		}
+		friend bool operator!=(const var& a, const var& b)
+		{
+			return a.x != b.x;
+		}
+		friend bool operator<(const var& a, const var& b)
+		{
+			return a.x < b.x;
+		}
+		friend bool operator<=(const var& a, const var& b)
+		{
+			return a.x <= b.x;
+		}
+		friend bool operator>(const var& a, const var& b)
+		{
+			return a.x > b.x;
+		}
+		friend bool operator>=(const var& a, const var& b)
+		{
+			return a.x >= b.x;
+		}
+
+		friend var exp(const var& a)
+		{
+			double y = std::exp(a.x);
+
+			return record(y, a, y);
+		}
+		friend var log(const var& a)
+		{
+			return record(std::log(a.x), a, 1 / a.x);
+		}
+		friend var log1p(const var& a)
+		{
+			return record(std::log1p(a.x), a, 1 / (1 + a.x));
+		}
+		friend var sqrt(const var& a)
+		{
+			double y = std::sqrt(a.x);
+
+			return record(y, a, 0.5 / y);
+		}
+		friend var pow(const var& a, double b)
+		{
+			return record(std::pow(a.x, b), a, b * std::pow(a.x, b - 1));
+		}
+		friend var pow(const var& a, const var& b)
+		{
+			double y = std::pow(a.x, b.x);
+
+			return record(y, a, b.x * std::pow(a.x, b.x - 1), b, y * std::log(a.x));
+		}
+		friend var fabs(const var& a)
+		{
+			return a.x < 0 ? -a : a;
+		}
+		friend var abs(const var& a)
+		{
+			return fabs(a);
+		}
+		friend var max(const var& a, const var& b)
+		{
+			return a.x < b.x ? b : a;
+		}
+		friend var min(const var& a, const var& b)
+		{
+			return b.x < a.x ? b : a;
+		}
+		friend var erf(const var& a)
+		{
+			constexpr double c = 1.12837916709551257390; // 2/sqrt(pi)
+
+			return record(std::erf(a.x), a, c * std::exp(-a.x * a.x));
+		}
+		friend var erfc(const var& a)
+		{
+			constexpr double c = 1.12837916709551257390;
+
+			return record(std::erfc(a.x), a, -c * std::exp(-a.x * a.x));
+		}
+		friend bool signbit(const var& a)
+		{
+			return std::signbit(a.x);
+		}
+		friend bool isnan(const var& a)
+		{
+			return std::isnan(a.x);
+		}
+		friend bool isfinite(const var& a)
+		{
+			return std::isfinite(a.x);
+		}
+	};
+
+} // namespace fms::adjoint
+
+namespace std {
+
+	template<>
+	class numeric_limits<fms::adjoint::var> : public numeric_limits<double> {
+	public:
+		static constexpr fms::adjoint::var quiet_NaN() noexcept
+		{
+			return fms::adjoint::var(numeric_limits<double>::quiet_NaN());
+		}
+		static constexpr fms::adjoint::var infinity() noexcept
+		{
+			return fms::adjoint::var(numeric_limits<double>::infinity());
+		}
+		static constexpr fms::adjoint::var epsilon() noexcept
+		{
+			return fms::adjoint::var(numeric_limits<double>::epsilon());
+		}
+		static constexpr fms::adjoint::var max() noexcept
+		{
+			return fms::adjoint::var((numeric_limits<double>::max)());
+		}
+		static constexpr fms::adjoint::var min() noexcept
+		{
+			return fms::adjoint::var((numeric_limits<double>::min)());
+		}
+		static constexpr fms::adjoint::var lowest() noexcept
+		{
+			return fms::adjoint::var(numeric_limits<double>::lowest());
+		}
+	};
+
+} // namespace std
+
+namespace fms::variate {
+
+	// Lift P^s(X <= x) and kappa(s) to the tape using the derivatives
+	// with respect to x and s each variate provides.
+	inline adjoint::var cdf(const base& v, const adjoint::var& x, const adjoint::var& s, unsigned nx = 0, unsigned ns = 0)
+	{
+		using adjoint::none;
+
+		double dx = x.i != none ? cdf(v, x.x, s.x, nx + 1, ns) : 0;
+		double ds = s.i != none ? cdf(v, x.x, s.x, nx, ns + 1) : 0;
+
+		return adjoint::var::record(cdf(v, x.x, s.x, nx, ns), x, dx, s, ds);
+	}
+
+	inline adjoint::var cumulant(const base& v, const adjoint::var& s, unsigned n = 0)
+	{
+		double ds = s.i != adjoint::none ? cumulant(v, s.x, n + 1) : 0;
+
+		return adjoint::var::record(cumulant(v, s.x, n), s, ds);
+	}
+
+} // namespace fms::variate
@@ -0,0 +1,178 @@
+// fms_adjoint.t.cpp - Test reverse mode automatic differentiation
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include <random>
+#include "fms_adjoint.h"
+#include "fms_dual.h"
+#include "fms_monte_carlo.h"
+#include "fms_option.h"
+#include "fms_pwflat.h"
+#include "fms_variate_normal.h"
+
+using namespace fms;
+using namespace fms::adjoint;
+using namespace fms::variate;
+
+int adjoint_arena_test()
+{
+	arena<int, 4> a;
+	for (int i = 0; i < 10; ++i) {
+		assert(a.push_back(i) == size_t(i));
+	}
+	assert(a.size() == 10);
+	assert(a.capacity() == 12);
+	assert(a[9] == 9);
+	a.clear();
+	assert(a.size() == 0);
+	for (int i = 0; i < 12; ++i) {
+		a.push_back(-i);
+	}
+	assert(a.capacity() == 12);
+	assert(a[11] == -11);
+
+	return 0;
+}
+int adjoint_arena_test_ = adjoint_arena_test();
+
+int adjoint_var_test()
+{
+	auto& t = tape::active();
+	t.clear();
+
+	var x = var::variable(0.5), y = var::variable(2);
+	// z = x y + e^x/y - sqrt(y) log(x)
+	var z = x * y + exp(x) / y - sqrt(y) * log(x);
+	size_t n = t.size();
+	t.backward(z.i);
+	assert(fabs(x.adjoint() - (2 + exp(0.5) / 2 - sqrt(2.) / 0.5)) < 1e-15);
+	assert(fabs(y.adjoint() - (0.5 - exp(0.5) / 4 - log(0.5) / (2 * sqrt(2.)))) < 1e-15);
+
+	// constants are not recorded
+	var c = z * 2. + 3.;
+	assert(t.size() == n + 2);
+	assert(c.x == z.x * 2 + 3);
+	var d = var(2.) * var(3.);
+	assert(d.i == none && d.x == 6);
+
+	t.clear();
+	assert(t.size() == 0);
+
+	return 0;
+}
+int adjoint_var_test_ = adjoint_var_test();
+
+int adjoint_option_test()
+{
+	normal N;
+	auto& t = tape::active();
+
+	for (double k : { -110., -90., 90., 110. }) {
+		// all black greeks from one backward sweep
+		double f = 100, s = 0.2;
+		t.clear();
+		var f_ = var::variable(f), s_ = var::variable(s), k_ = var::variable(k);
+		var v = option::black::value(N, f_, s_, k_);
+		t.backward(v.i);
+		assert(v.x == option::black::value(N, f, s, k));
+		assert(fabs(f_.adjoint() - option::black::delta(N, f, s, k)) < 1e-14);
+		assert(fabs(s_.adjoint() - option::black::vega(N, f, s, k)) < 1e-12);
+		auto dk = option::black::value<dual<>>(N, f, s, dual<>(k, 1));
+		assert(fabs(k_.adjoint() - dk.dx) < 1e-14);
+
+		// all bsm sensitivities match forward mode
+		int c = k < 0 ? option::contract::PUT : option::contract::CALL;
+		double x[] = { 0.05, 100, 0.2, fabs(k), 0.5 }; // r, S, sigma, k, t
+		t.clear();
+		var x_[5];
+		for (int i = 0; i < 5; ++i) {
+			x_[i] = var::variable(x[i]);
+		}
+		var b = option::bsm::value(N, x_[0], x_[1], x_[2], c, x_[3], x_[4]);
+		t.backward(b.i);
+		for (int i = 0; i < 5; ++i) {
+			dual<> y[5] = { x[0], x[1], x[2], x[3], x[4] };
+			y[i].dx = 1;
+			auto db = option::bsm::value(N, y[0], y[1], y[2], c, y[3], y[4]);
+			assert(fabs(x_[i].adjoint() - db.dx) < 1e-12);
+		}
+	}
+
+	return 0;
+}
+int adjoint_option_test_ = adjoint_option_test();
+
+int adjoint_pwflat_test()
+{
+	auto& t = tape::active();
+	double t_[] = { 1, 2, 3 };
+	double f[] = { .01, .02, .03 };
+	double u[] = { 0.5, 1, 1.5, 2.5, 3.5 };
+	double c[] = { .02, .02, .02, .02, 1.02 };
+
+	t.clear();
+	var f_[3];
+	for (int i = 0; i < 3; ++i) {
+		f_[i] = var::variable(f[i]);
+	}
+	var _f = var::variable(.04);
+	pwflat::curve<double, var> v(3, t_, f_, _f);
+	var pv = 0;
+	for (int j = 0; j < 5; ++j) {
+		pv += c[j] * v.discount(u[j]);
+	}
+	t.backward(pv.i);
+
+	pwflat::curve<> d(3, t_, f, .04);
+	double dpv[4];
+	assert(fabs(pv.x - d.present_value(5, u, c, dpv)) < 1e-15);
+	for (int i = 0; i < 3; ++i) {
+		assert(fabs(f_[i].adjoint() - dpv[i]) < 1e-15);
+	}
+	assert(fabs(_f.adjoint() - dpv[3]) < 1e-15);
+
+	return 0;
+}
+int adjoint_pwflat_test_ = adjoint_pwflat_test();
+
+int adjoint_monte_carlo_test()
+{
+	// pathwise delta and vega of a call
+	double f = 100, s = 0.2, k = 105;
+	size_t n = 1000;
+	auto& t = tape::active();
+
+	t.clear();
+	var f_ = var::variable(f), s_ = var::variable(s);
+	std::default_random_engine dre;
+	std::normal_distribution<double> Z;
+	auto payoff = [&]() {
+		var F = f_ * exp(s_ * Z(dre) - s_ * s_ / 2.);
+
+		return max(F - k, 0.);
+	};
+	var v = monte_carlo::average(n, payoff);
+	t.backward(v.i);
+
+	// same draws without the tape
+	double v_ = 0, df = 0, ds = 0;
+	dre.seed(std::default_random_engine::default_seed);
+	Z.reset();
+	for (size_t m = 0; m < n; ++m) {
+		double z = Z(dre);
+		double F = f * exp(s * z - s * s / 2);
+		if (F > k) {
+			v_ += F - k;
+			df += F / f;
+			ds += F * (z - s);
+		}
+	}
+	assert(fabs(v.x - v_ / n) < 1e-12);
+	assert(fabs(f_.adjoint() - df / n) < 1e-12);
+	assert(fabs(s_.adjoint() - ds / n) < 1e-10);
+
+	return 0;
+}
+int adjoint_monte_carlo_test_ = adjoint_monte_carlo_test();
+
+#endif // _DEBUG
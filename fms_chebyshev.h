@@ -0,0 +1,220 @@
+// fms_chebyshev.h - Tensor product Chebyshev interpolation
+// Sample a function on the product of Chebyshev nodes of the first kind
+// x_k = cos(pi (k + 1/2)/n), k = 0, ..., n - 1, mapped to [a, b] in each dimension
+// and store the coefficients of sum_i c_i T_i0(x0) ... T_iD-1(xD-1).
+// Evaluation contracts one dimension at a time with T_j(x_d) from the
+// three term recurrence, or uses Clenshaw's recurrence in one dimension.
+// Smooth functions such as option values in forward and volatility converge
+// geometrically in the number of nodes so a cheap proxy can replace an
+// expensive pricer inside scenario loops.
+//
+//	chebyshev::proxy<2> p({ 16, 16 }, { 80, .1 }, { 120, .4 }, [&](const auto& x) {
+//		return option::black::value(T, x[0], x[1], k);
+//	});
+//	double v = p({ f, s });
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace fms::chebyshev {
+
+	// k-th of n Chebyshev nodes on [-1, 1] in decreasing order
+	inline double node(size_t k, size_t n)
+	{
+		constexpr double pi = 3.14159265358979323846;
+
+		return cos(pi * (k + 0.5) / n);
+	}
+
+	// sum_{i < n} c[i stride] T_i(t) using Clenshaw's recurrence
+	inline double clenshaw(double t, size_t n, const double* c, size_t stride = 1)
+	{
+		double b1 = 0, b2 = 0;
+
+		for (size_t i = n; i-- > 1; ) {
+			double b0 = 2 * t * b1 - b2 + c[i * stride];
+			b2 = b1;
+			b1 = b0;
+		}
+
+		return t * b1 - b2 + c[0];
+	}
+
+	template<size_t D>
+	class proxy {
+		std::array<size_t, D> n;
+		std::array<double, D> a, b;
+		std::array<size_t, D> stride; // of dimension d in c
+		std::vector<double> c;
+		size_t ws; // scratch size for evaluation
+
+	public:
+		// Interpolate g(x) on [a, b] using n[d] nodes in dimension d.
+		// g is called with a std::array<double, D> once per node.
+		template<class G>
+		proxy(const std::array<size_t, D>& n, const std::array<double, D>& a, const std::array<double, D>& b, G&& g)
+			: n(n), a(a), b(b)
+		{
+			size_t N = 1;
+			for (size_t d = D; d-- > 0; ) {
+				stride[d] = N;
+				N *= n[d];
+			}
+			c.resize(N);
+			// T_j for each dimension and one value per line of the last dimension
+			ws = N / n[D - 1];
+			for (size_t d = 0; d < D; ++d) {
+				ws += n[d];
+			}
+
+			// values at nodes
+			std::array<double, D> x;
+			for (size_t i = 0; i < N; ++i) {
+				for (size_t d = 0; d < D; ++d) {
+					size_t k = (i / stride[d]) % n[d];
+					x[d] = (a[d] + b[d]) / 2 + (b[d] - a[d]) / 2 * node(k, n[d]);
+				}
+				c[i] = g(x);
+			}
+
+			// discrete cosine transform along each dimension
+			constexpr double pi = 3.14159265358979323846;
+			std::vector<double> y, T;
+			for (size_t d = 0; d < D; ++d) {
+				size_t m = n[d];
+				// T[j m + k] = T_j(x_k) = cos(pi j (k + 1/2)/m)
+				T.resize(m * m);
+				for (size_t j = 0; j < m; ++j) {
+					for (size_t k = 0; k < m; ++k) {
+						T[j * m + k] = cos(pi * j * (k + 0.5) / m);
+					}
+				}
+				y.resize(m);
+				for (size_t i = 0; i < N; ++i) {
+					if ((i / stride[d]) % m != 0) {
+						continue; // not the start of a line in dimension d
+					}
+					for (size_t j = 0; j < m; ++j) {
+						double s = 0;
+						for (size_t k = 0; k < m; ++k) {
+							s += T[j * m + k] * c[i + k * stride[d]];
+						}
+						y[j] = (j == 0 ? 1. : 2.) * s / m;
+					}
+					for (size_t j = 0; j < m; ++j) {
+						c[i + j * stride[d]] = y[j];
+					}
+				}
+			}
+		}
+
+		// number of coefficients
+		size_t size() const
+		{
+			return c.size();
+		}
+		const std::vector<double>& coefficients() const
+		{
+			return c;
+		}
+
+		// number of doubles of scratch space used by operator()(x, w)
+		size_t scratch() const
+		{
+			return ws;
+		}
+
+		// interpolated value or NaN outside the domain using scratch space w
+		double operator()(const std::array<double, D>& x, double* w) const
+		{
+			std::array<double, D> t;
+			for (size_t d = 0; d < D; ++d) {
+				if (!(a[d] <= x[d] && x[d] <= b[d])) {
+					return std::numeric_limits<double>::quiet_NaN();
+				}
+				t[d] = (2 * x[d] - a[d] - b[d]) / (b[d] - a[d]);
+			}
+			if constexpr (D == 1) {
+				return clenshaw(t[0], n[0], c.data());
+			}
+
+			// Contract the last dimension first. The sums over each line of coefficients
+			// are independent so they are accumulated together instead of using
+			// nested Clenshaw recurrences that each wait on the previous step.
+			// Line i only reads entries at or after i so later contractions are in place.
+			size_t L = c.size() / n[D - 1]; // number of lines in dimension d
+			double* y = w;
+			double* T = y + L;
+			const double* z = c.data();
+			for (size_t d = D; d-- > 0; ) {
+				T[0] = 1;
+				if (n[d] > 1) {
+					T[1] = t[d];
+				}
+				for (size_t j = 2; j < n[d]; ++j) {
+					T[j] = 2 * t[d] * T[j - 1] - T[j - 2];
+				}
+				for (size_t i = 0; i < L; ++i) {
+					const double* zi = z + i * n[d];
+					// two partial sums halve the length of the dependency chain
+					double s0 = 0, s1 = 0;
+					size_t j = 0;
+					for (; j + 1 < n[d]; j += 2) {
+						s0 += zi[j] * T[j];
+						s1 += zi[j + 1] * T[j + 1];
+					}
+					if (j < n[d]) {
+						s0 += zi[j] * T[j];
+					}
+					y[i] = s0 + s1;
+				}
+				z = y;
+				T += n[d];
+				if (d > 0) {
+					L /= n[d - 1];
+				}
+			}
+
+			return z[0];
+		}
+		// Use a stack buffer when the scratch space is small enough.
+		// Call operator()(x, w) in loops over large grids to avoid allocating.
+		double operator()(const std::array<double, D>& x) const
+		{
+			constexpr size_t M = 512;
+			if (ws <= M) {
+				double w_[M];
+
+				return operator()(x, w_);
+			}
+			std::vector<double> w_(ws);
+
+			return operator()(x, w_.data());
+		}
+
+		// Estimate of the interpolation error: the sum of |c_i| over coefficients
+		// of the highest degree in any dimension. Rapid decay of the coefficients
+		// means the omitted terms are smaller still.
+		double error() const
+		{
+			double e = 0;
+
+			for (size_t i = 0; i < c.size(); ++i) {
+				for (size_t d = 0; d < D; ++d) {
+					if ((i / stride[d]) % n[d] == n[d] - 1) {
+						e += fabs(c[i]);
+
+						break;
+					}
+				}
+			}
+
+			return e;
+		}
+	};
+
+} // namespace fms::chebyshev
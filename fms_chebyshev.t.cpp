@@ -0,0 +1,94 @@
+// fms_chebyshev.t.cpp - Test Chebyshev interpolation
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include <vector>
+#include "fms_chebyshev.h"
+#include "fms_option.h"
+#include "fms_variate_normal.h"
+#include "fms_variate_triangular.h"
+
+using namespace fms;
+
+int chebyshev_test()
+{
+	{
+		// polynomials of degree less than n are exact
+		chebyshev::proxy<1> p({ 4 }, { -1 }, { 3 }, [](const auto& x) { return 1 + x[0] * (2 - x[0] * x[0]); });
+		for (double x : { -1., 0., 0.5, 3. }) {
+			assert(fabs(p({ x }) - (1 + x * (2 - x * x))) < 1e-13);
+		}
+		assert(std::isnan(p({ 3.5 })));
+	}
+	{
+		// error estimate bounds the interpolation error of exp without being too pessimistic
+		chebyshev::proxy<1> p({ 8 }, { 0 }, { 1 }, [](const auto& x) { return exp(x[0]); });
+		double e = 0;
+		for (double x = 0; x <= 1; x += 1. / 1024) {
+			e = std::max(e, fabs(p({ x }) - exp(x)));
+		}
+		assert(e > 0 && e <= p.error() && p.error() <= 100 * e);
+	}
+	{
+		// caller scratch space and the heap fallback for large grids agree with the stack buffer
+		chebyshev::proxy<3> p({ 24, 24, 3 }, { 0, 0, 0 }, { 1, 2, 1 }, [](const auto& x) { return exp(x[0]) * sin(x[1]) * (1 + x[2] * x[2]); });
+		assert(p.scratch() > 512);
+		std::vector<double> w(p.scratch());
+		for (double x : { 0., 0.3, 1. }) {
+			double v = exp(x) * sin(2 * x) * (1 + x * x);
+			assert(p({ x, 2 * x, x }) == p({ x, 2 * x, x }, w.data()));
+			assert(fabs(p({ x, 2 * x, x }) - v) < 1e-12);
+		}
+	}
+	{
+		// T_2(x) T_1(y)
+		chebyshev::proxy<2> p({ 3, 2 }, { -1, -1 }, { 1, 1 }, [](const auto& x) { return (2 * x[0] * x[0] - 1) * x[1]; });
+		const auto& c = p.coefficients();
+		for (size_t i = 0; i < c.size(); ++i) {
+			assert(fabs(c[i] - (i == 2 * 2 + 1)) < 1e-15);
+		}
+	}
+
+	return 0;
+}
+int chebyshev_test_ = chebyshev_test();
+
+int chebyshev_option_test()
+{
+	{
+		// black value in forward and vol
+		variate::normal N;
+		double k = 100;
+		chebyshev::proxy<2> p({ 24, 24 }, { 80, 0.1 }, { 120, 0.4 }, [&](const auto& x) {
+			return option::black::value(N, x[0], x[1], k);
+		});
+		assert(p.error() < 1e-9);
+		std::vector<double> w(p.scratch());
+		for (double f = 80; f <= 120; f += 3.3) {
+			for (double s = 0.1; s <= 0.4; s += 0.037) {
+				assert(fabs(p({ f, s }) - option::black::value(N, f, s, k)) < 1e-9);
+				assert(p({ f, s }, w.data()) == p({ f, s }));
+			}
+		}
+	}
+	{
+		// triangular put in forward, vol, and strike
+		variate::triangular T(-1, 0, 2);
+		chebyshev::proxy<3> p({ 12, 12, 12 }, { 90, 0.1, 95 }, { 110, 0.3, 105 }, [&](const auto& x) {
+			return option::black::value(T, x[0], x[1], -x[2]);
+		});
+		double e = p.error();
+		for (double f : { 91., 100., 108. }) {
+			for (double s : { 0.12, 0.2, 0.27 }) {
+				for (double k : { 96., 100., 104. }) {
+					assert(fabs(p({ f, s, k }) - option::black::value(T, f, s, -k)) < e);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+int chebyshev_option_test_ = chebyshev_option_test();
+
+#endif // _DEBUG
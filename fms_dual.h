@@ -0,0 +1,337 @@
+// fms_dual.h - Forward mode automatic differentiation
+// A dual number x + dx e with e^2 = 0 carries a derivative through a calculation:
+// f(x + dx e) = f(x) + f'(x) dx e. Seed dx = 1 on one input to get the derivative
+// of the result with respect to that input from a single evaluation.
+// Use dual<dual<>> for second derivatives.
+//
+// Functions are hidden friends so they are found only by argument dependent lookup
+// and do not hide the standard functions in generic code.
+#pragma once
+#include <cmath>
+#include <limits>
+#include "fms_variate.h"
+
+namespace fms {
+
+	template<class X = double>
+	struct dual {
+		X x, dx;
+
+		constexpr dual(X x = 0, X dx = 0)
+			: x(x), dx(dx)
+		{ }
+
+		dual operator-() const
+		{
+			return dual(-x, -dx);
+		}
+		dual operator+() const
+		{
+			return *this;
+		}
+
+		dual& operator+=(const dual& b)
+		{
+			x += b.x;
+			dx += b.dx;
+
+			return *this;
+		}
+		dual& operator-=(const dual& b)
+		{
+			x -= b.x;
+			dx -= b.dx;
+
+			return *this;
+		}
+		dual& operator*=(const dual& b)
+		{
+			dx = dx * b.x + x * b.dx;
+			x *= b.x;
+
+			return *this;
+		}
+		dual& operator/=(const dual& b)
+		{
+			dx = (dx * b.x - x * b.dx) / (b.x * b.x);
+			x /= b.x;
+
+			return *this;
+		}
+
+		friend dual operator+(dual a, const dual& b)
+		{
+			return a += b;
+		}
+		friend dual operator+(dual a, const X& b)
+		{
+			return a += dual(b);
+		}
+		friend dual operator+(const X& a, dual b)
+		{
+			return b += dual(a);
+		}
+		friend dual operator-(dual a, const dual& b)
+		{
+			return a -= b;
+		}
+		friend dual operator-(dual a, const X& b)
+		{
+			return a -= dual(b);
+		}
+		friend dual operator-(const X& a, const dual& b)
+		{
+			return dual(a) -= b;
+		}
+		friend dual operator*(dual a, const dual& b)
+		{
+			return a *= b;
+		}
+		friend dual operator*(const dual& a, const X& b)
+		{
+			return dual(a.x * b, a.dx * b);
+		}
+		friend dual operator*(const X& a, const dual& b)
+		{
+			return dual(a * b.x, a * b.dx);
+		}
+		friend dual operator/(dual a, const dual& b)
+		{
+			return a /= b;
+		}
+		friend dual operator/(const dual& a, const X& b)
+		{
+			return dual(a.x / b, a.dx / b);
+		}
+		friend dual operator/(const X& a, const dual& b)
+		{
+			return dual(a) /= b;
+		}
+
+		// compare values
+		friend bool operator==(const dual& a, const dual& b)
+		{
+			return a.x == b.x;
+		}
+		friend bool operator!=(const dual& a, const dual& b)
+		{
+			return a.x != b.x;
+		}
+		friend bool operator<(const dual& a, const dual& b)
+		{
+			return a.x < b.x;
+		}
+		friend bool operator<=(const dual& a, const dual& b)
+		{
+			return a.x <= b.x;
+		}
+		friend bool operator>(const dual& a, const dual& b)
+		{
+			return a.x > b.x;
+		}
+		friend bool operator>=(const dual& a, const dual& b)
+		{
+			return a.x >= b.x;
+		}
+		friend bool operator==(const dual& a, const X& b)
+		{
+			return a.x == b;
+		}
+		friend bool operator!=(const dual& a, const X& b)
+		{
+			return a.x != b;
+		}
+		friend bool operator<(const dual& a, const X& b)
+		{
+			return a.x < b;
+		}
+		friend bool operator<=(const dual& a, const X& b)
+		{
+			return a.x <= b;
+		}
+		friend bool operator>(const dual& a, const X& b)
+		{
+			return a.x > b;
+		}
+		friend bool operator>=(const dual& a, const X& b)
+		{
+			return a.x >= b;
+		}
+		friend bool operator<(const X& a, const dual& b)
+		{
+			return a < b.x;
+		}
+		friend bool operator<=(const X& a, const dual& b)
+		{
+			return a <= b.x;
+		}
+		friend bool operator>(const X& a, const dual& b)
+		{
+			return a > b.x;
+		}
+		friend bool operator>=(const X& a, const dual& b)
+		{
+			return a >= b.x;
+		}
+
+		// f(x + dx e) = f(x) + f'(x) dx e
+		friend dual exp(const dual& a)
+		{
+			using std::exp;
+			X ex = exp(a.x);
+
+			return dual(ex, ex * a.dx);
+		}
+		friend dual log(const dual& a)
+		{
+			using std::log;
+
+			return dual(log(a.x), a.dx / a.x);
+		}
+		friend dual log1p(const dual& a)
+		{
+			using std::log1p;
+
+			return dual(log1p(a.x), a.dx / (1 + a.x));
+		}
+		friend dual sqrt(const dual& a)
+		{
+			using std::sqrt;
+			X sx = sqrt(a.x);
+
+			return dual(sx, a.dx / (2 * sx));
+		}
+		friend dual pow(const dual& a, const X& b)
+		{
+			using std::pow;
+
+			return dual(pow(a.x, b), b * pow(a.x, b - 1) * a.dx);
+		}
+		friend dual pow(const dual& a, const dual& b)
+		{
+			return exp(b * log(a));
+		}
+		friend dual fabs(const dual& a)
+		{
+			return a.x < 0 ? -a : a;
+		}
+		friend dual abs(const dual& a)
+		{
+			return fabs(a);
+		}
+		friend dual erf(const dual& a)
+		{
+			using std::erf;
+			using std::exp;
+			constexpr double c = 1.12837916709551257390; // 2/sqrt(pi)
+
+			return dual(erf(a.x), c * exp(-a.x * a.x) * a.dx);
+		}
+		friend dual erfc(const dual& a)
+		{
+			using std::erfc;
+			using std::exp;
+			constexpr double c = 1.12837916709551257390;
+
+			return dual(erfc(a.x), -c * exp(-a.x * a.x) * a.dx);
+		}
+		friend bool signbit(const dual& a)
+		{
+			using std::signbit;
+
+			return signbit(a.x);
+		}
+		friend bool isnan(const dual& a)
+		{
+			using std::isnan;
+
+			return isnan(a.x);
+		}
+		friend bool isfinite(const dual& a)
+		{
+			using std::isfinite;
+
+			return isfinite(a.x);
+		}
+	};
+
+	// true if any component of a possibly nested dual is not zero
+	// Comparison operators only use the value.
+	inline bool nonzero(double x)
+	{
+		return x != 0;
+	}
+	template<class X>
+	inline bool nonzero(const dual<X>& x)
+	{
+		return nonzero(x.x) || nonzero(x.dx);
+	}
+
+} // namespace fms
+
+namespace std {
+
+	template<class X>
+	class numeric_limits<fms::dual<X>> : public numeric_limits<X> {
+	public:
+		static constexpr fms::dual<X> quiet_NaN() noexcept
+		{
+			return fms::dual<X>(std::numeric_limits<X>::quiet_NaN());
+		}
+		static constexpr fms::dual<X> infinity() noexcept
+		{
+			return fms::dual<X>(std::numeric_limits<X>::infinity());
+		}
+		static constexpr fms::dual<X> epsilon() noexcept
+		{
+			return fms::dual<X>(std::numeric_limits<X>::epsilon());
+		}
+		static constexpr fms::dual<X> max() noexcept
+		{
+			return fms::dual<X>((std::numeric_limits<X>::max)());
+		}
+		static constexpr fms::dual<X> min() noexcept
+		{
+			return fms::dual<X>((std::numeric_limits<X>::min)());
+		}
+		static constexpr fms::dual<X> lowest() noexcept
+		{
+			return fms::dual<X>(std::numeric_limits<X>::lowest());
+		}
+	};
+
+} // namespace std
+
+namespace fms::variate {
+
+	// Lift P^s(X <= x) and kappa(s) to dual numbers using the derivatives
+	// with respect to x and s each variate provides.
+	// Derivatives are only requested for arguments that carry one.
+	template<class X>
+	inline dual<X> cdf(const base& v, const dual<X>& x, const dual<X>& s, unsigned nx = 0, unsigned ns = 0)
+	{
+		dual<X> p(cdf(v, x.x, s.x, nx, ns));
+
+		if (nonzero(x.dx)) {
+			p.dx += cdf(v, x.x, s.x, nx + 1, ns) * x.dx;
+		}
+		if (nonzero(s.dx)) {
+			p.dx += cdf(v, x.x, s.x, nx, ns + 1) * s.dx;
+		}
+
+		return p;
+	}
+
+	template<class X>
+	inline dual<X> cumulant(const base& v, const dual<X>& s, unsigned n = 0)
+	{
+		dual<X> k(cumulant(v, s.x, n));
+
+		if (nonzero(s.dx)) {
+			k.dx = cumulant(v, s.x, n + 1) * s.dx;
+		}
+
+		return k;
+	}
+
+} // namespace fms::variate
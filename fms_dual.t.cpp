@@ -0,0 +1,165 @@
+// fms_dual.t.cpp - Test forward mode automatic differentiation
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include "fms_dual.h"
+#include "fms_option.h"
+#include "fms_pwflat.h"
+#include "fms_variate_normal.h"
+
+using namespace fms;
+using namespace fms::variate;
+
+int dual_test()
+{
+	for (double x : { 0.1, 0.5, 2. }) {
+		dual<> x_(x, 1);
+		{
+			// (x^2 e^x/(1 + x))' = x e^x (x^2 + 2x + 2)/(1 + x)^2
+			auto y = x_ * x_ * exp(x_) / (1 + x_);
+			assert(y.x == x * x * exp(x) / (1 + x));
+			assert(fabs(y.dx - x * exp(x) * (x * x + 2 * x + 2) / ((1 + x) * (1 + x))) < 1e-13);
+		}
+		{
+			assert(fabs(log(x_).dx - 1 / x) < 1e-15);
+			assert(fabs(sqrt(x_).dx - 0.5 / sqrt(x)) < 1e-15);
+			assert(fabs(pow(x_, 3.).dx - 3 * x * x) < 1e-14);
+			assert(fabs(pow(x_, x_).dx - pow(x, x) * (log(x) + 1)) < 1e-14);
+			assert(fabs(erfc(x_).dx + 2 * exp(-x * x) / sqrt(acos(-1.))) < 1e-15);
+			assert((x - x_).dx == -1);
+			assert((2 / x_).dx == -2 / (x * x));
+		}
+		{
+			// second derivative of e^{x^2} is (2 + 4x^2) e^{x^2}
+			dual<dual<>> x2(dual<>(x, 1), dual<>(1));
+			auto y = exp(x2 * x2);
+			assert(fabs(y.dx.dx - (2 + 4 * x * x) * exp(x * x)) < 1e-12);
+		}
+	}
+
+	return 0;
+}
+int dual_test_ = dual_test();
+
+int dual_variate_test()
+{
+	normal N;
+	double x = 0.3, s = 0.2;
+
+	// t = 0 + e1 + e2 so the first order part of t^2 has value 0 and derivative 2
+	dual<dual<>> t(dual<>(0, 1), dual<>(1, 0));
+	auto t2 = t * t;
+	assert(t2.dx.x == 0 && t2.dx.dx == 2);
+	{
+		// d^2/dt^2 P^s(X <= x + t^2) = 2 P^s'(x)
+		auto p = variate::cdf(N, x + t2, dual<dual<>>(s));
+		assert(fabs(p.dx.dx - 2 * N.cdf(x, s, 1)) < 1e-15);
+		// d^2/dt^2 P^{s + t^2}(X <= x) = 2 dP^s/ds
+		p = variate::cdf(N, dual<dual<>>(x), s + t2);
+		assert(fabs(p.dx.dx - 2 * N.cdf(x, s, 0, 1)) < 1e-15);
+		// d^2/dt^2 P^{s + t}(X <= x + t) includes the cross derivative
+		p = variate::cdf(N, x + t, s + t);
+		double d2 = N.cdf(x, s, 2) + 2 * N.cdf(x, s, 1, 1) + N.cdf(x, s, 0, 2);
+		assert(fabs(p.dx.dx - d2) < 1e-14);
+	}
+	{
+		// d^2/dt^2 kappa(s + t^2) = 2 kappa'(s)
+		auto k = variate::cumulant(N, s + t2);
+		assert(fabs(k.dx.dx - 2 * N.cumulant(s, 1)) < 1e-15);
+	}
+
+	return 0;
+}
+int dual_variate_test_ = dual_variate_test();
+
+int dual_option_test()
+{
+	normal N;
+	double f = 100, s = 0.2, r = 0.05, sigma = 0.2, t = 0.5;
+
+	for (double k : { -110., -90., 90., 110. }) {
+		{
+			// black delta and vega in one pricing each
+			auto df = option::black::value<dual<>>(N, dual<>(f, 1), s, k);
+			auto ds = option::black::value<dual<>>(N, f, dual<>(s, 1), k);
+			assert(df.x == option::black::value(N, f, s, k));
+			assert(fabs(df.dx - option::black::delta(N, f, s, k)) < 1e-14);
+			assert(fabs(ds.dx - option::black::vega(N, f, s, k)) < 1e-12);
+
+			// gamma from dual delta
+			auto g = option::black::delta<dual<>>(N, dual<>(f, 1), s, k);
+			assert(fabs(g.dx - option::black::gamma(N, f, s, k)) < 1e-15);
+
+			auto d = option::digital::value<dual<>>(N, dual<>(f, 1), s, k);
+			assert(fabs(d.dx - option::digital::delta(N, f, s, k)) < 1e-15);
+		}
+		{
+			// bsm theta = -dv/dt
+			int c = k < 0 ? option::contract::PUT : option::contract::CALL;
+			auto v = option::bsm::value<dual<>>(N, r, f, sigma, c, fabs(k), dual<>(t, 1));
+			double h = 1e-5;
+			double dv = (option::bsm::value(N, r, f, sigma, c, fabs(k), t + h)
+				- option::bsm::value(N, r, f, sigma, c, fabs(k), t - h)) / (2 * h);
+			assert(fabs(v.dx - dv) < 1e-7);
+			for (int c_ : { c, k < 0 ? int(option::contract::DIGITAL_PUT) : int(option::contract::DIGITAL_CALL) }) {
+				auto v_ = option::bsm::value<dual<>>(N, r, f, sigma, c_, fabs(k), dual<>(t, 1));
+				assert(fabs(option::bsm::theta(N, r, f, sigma, c_, fabs(k), t) + v_.dx) < 1e-13);
+			}
+			auto s_ = sigma * sqrt(dual<>(t, 1));
+			assert(fabs(option::black::theta(N, f, sigma, k, t) + option::black::value(N, dual<>(f), s_, dual<>(k)).dx) < 1e-13);
+			assert(fabs(option::digital::theta(N, f, sigma, k, t) + option::digital::value(N, dual<>(f), s_, dual<>(k)).dx) < 1e-15);
+
+			// rho
+			auto dr = option::bsm::value<dual<>>(N, dual<>(r, 1), f, sigma, c, fabs(k), t);
+			dv = (option::bsm::value(N, r + h, f, sigma, c, fabs(k), t)
+				- option::bsm::value(N, r - h, f, sigma, c, fabs(k), t)) / (2 * h);
+			assert(fabs(dr.dx - dv) < 1e-7);
+		}
+	}
+	{
+		// double overloads accept mixed int and double arguments
+		assert(option::black::value(N, 100, 0.2, 80 + 1) == option::black::value(N, 100., 0.2, 81.));
+		assert(option::black::delta(N, 100, 0.2, -90) == option::black::delta(N, 100., 0.2, -90.));
+		assert(option::digital::value(N, 100, 0.2, 90) == option::digital::value(N, 100., 0.2, 90.));
+		assert(option::digital::delta(N, 100, 0.2, 90) == option::digital::delta(N, 100., 0.2, 90.));
+		assert(option::moneyness(N, 100, 0.2, 90) == option::moneyness(N, 100., 0.2, 90.));
+		assert(option::bsm::moneyness(N, 0.05, 100, 0.2, 90, 1) == option::bsm::moneyness(N, 0.05, 100., 0.2, 90., 1.));
+		assert(option::bsm::value(N, 0, 100, 0.2, option::contract::CALL, 90, 1)
+			== option::bsm::value(N, 0., 100., 0.2, option::contract::CALL, 90., 1.));
+		assert(option::bsm::delta(N, 0, 100, 0.2, option::contract::PUT, 90, 1)
+			== option::bsm::delta(N, 0., 100., 0.2, option::contract::PUT, 90., 1.));
+		assert(option::bsm::value<option::contract::CALL>(N, 0, 100, 0.2, 90, 1)
+			== option::bsm::value<option::contract::CALL>(N, 0., 100., 0.2, 90., 1.));
+		assert(option::bsm::delta<option::contract::PUT>(N, 0, 100, 0.2, 90, 1)
+			== option::bsm::delta<option::contract::PUT>(N, 0., 100., 0.2, 90., 1.));
+	}
+
+	return 0;
+}
+int dual_option_test_ = dual_option_test();
+
+int dual_pwflat_test()
+{
+	double t[] = { 1, 2, 3 };
+	double f[] = { .01, .02, .03 };
+	pwflat::curve<> c(3, t, f, .04);
+
+	for (size_t i = 0; i < 3; ++i) {
+		// seed forward i
+		dual<> f_[3] = { f[0], f[1], f[2] };
+		f_[i].dx = 1;
+		pwflat::curve<double, dual<>> c_(3, t, f_, dual<>(.04));
+		for (double u : { 0.5, 1.5, 2.5, 3.5 }) {
+			double dD[4];
+			size_t k = c.discount_gradient(u, dD);
+			auto D = c_.discount(u);
+			assert(fabs(D.x - c.discount(u)) < 1e-15);
+			assert(fabs(D.dx - (i < k ? dD[i] : 0)) < 1e-15);
+		}
+	}
+
+	return 0;
+}
+int dual_pwflat_test_ = dual_pwflat_test();
+
+#endif // _DEBUG
@@ -1,9 +1,14 @@
 // fsm_option.h - Option value and greeks
 #pragma once
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <limits>
 #include <tuple>
+#include <type_traits>
+#include <typeinfo>
 #include "fms_variate.h"
+#include "fms_variate_normal.h"
 
 using namespace fms::variate;
 
@@ -20,14 +25,31 @@ namespace fms {
 			DIGITAL_CALL = 'D',
 		};
 
+		// implied volatility result
+		enum implied_status {
+			IMPLIED_OK = 0,
+			IMPLIED_INVALID,         // f <= 0, k = 0, or input not finite
+			IMPLIED_BELOW_INTRINSIC, // value at or below intrinsic value
+			IMPLIED_ABOVE_MAXIMUM,   // value at or above f for calls or -k for puts
+			IMPLIED_NO_CONVERGENCE,  // maximum number of iterations reached
+		};
+
+		// Functions templated on X also accept dual numbers from fms_dual.h.
+		// Each has a double overload so arguments convert as usual, e.g. int strikes.
+
 		//  moneyness
-		inline double moneyness(const variate::base& v, double f, double s, double k)
+		template<class X = double>
+		inline X moneyness(const variate::base& v, X f, X s, X k)
 		{
 			if (f <= 0 || s <= 0 || k <= 0) {
 				return NaN;
 			}
 
-			return (log(k / f) + v.cumulant(s)) / s;
+			return (log(k / f) + cumulant(v, s)) / s;
+		}
+		inline double moneyness(const variate::base& v, double f, double s, double k)
+		{
+			return moneyness<double>(v, f, s, k);
 		}
 
 		// E[(F/f)^n 1(F <= k)] = e^{kappa(ns) - n kappa(s)} P_{ns}(X <= x)
@@ -52,12 +74,13 @@ namespace fms {
 		// Use 0 rate and forward values
 		namespace black {
 			// put (k < 0) or call (k > 0) option value
-			inline double value(const variate::base& v, double f, double s, double k)
+			template<class X = double>
+			inline X value(const variate::base& v, X f, X s, X k)
 			{
 				if (k < 0) { // put
-					double x = moneyness(v, f, s, -k);
+					X x = moneyness(v, f, s, -k);
 
-					return (-k) * v.cdf(x, 0) - f * v.cdf(x, s);
+					return (-k) * cdf(v, x, X(0)) - f * cdf(v, x, s);
 				}
 				else if (k > 0) { // call
 					// c = p + f - k
@@ -67,14 +90,19 @@ namespace fms {
 				// k = -/+ 0
 				return signbit(k) ? 0 : f;
 			}
+			inline double value(const variate::base& v, double f, double s, double k)
+			{
+				return value<double>(v, f, s, k);
+			}
 
 			// put (k < 0) or call (k > 0) option delta, dv/df
-			inline double delta(const variate::base& v, double f, double s, double k)
+			template<class X = double>
+			inline X delta(const variate::base& v, X f, X s, X k)
 			{
 				if (k < 0) { // put
-					double x = moneyness(v, f, s, -k);
+					X x = moneyness(v, f, s, -k);
 
-					return -v.cdf(x, s, 0, 0);
+					return -cdf(v, x, s);
 				}
 				else if (k > 0) { // call
 					// dc/df = dp/df + 1
@@ -83,6 +111,25 @@ namespace fms {
 
 				return signbit(k) ? 0 : 1;
 			}
+			inline double delta(const variate::base& v, double f, double s, double k)
+			{
+				return delta<double>(v, f, s, k);
+			}
+
+			// put (-1 < d < 0) or call (0 < d < 1) strike having delta d
+			// returns k < 0 for puts to match the value convention
+			inline double strike(const variate::base& v, double f, double s, double d)
+			{
+				if (f <= 0 || s <= 0 || d <= -1 || d >= 1 || d == 0) {
+					return NaN;
+				}
+
+				// put delta = -P^s(X <= x), call delta = 1 - P^s(X <= x)
+				double x = v.quantile(d < 0 ? -d : 1 - d, s);
+				double k = f * exp(s * x - v.cumulant(s));
+
+				return d < 0 ? -k : k;
+			}
 
 			// put (k < 0) or call (k > 0) option gamma, d^2v/df^2
 			inline double gamma(const variate::base& v, double f, double s, double k)
@@ -115,67 +162,360 @@ namespace fms {
 				return -f * v.cdf(x, s, 0, 1);
 			}
 
-			// put (k < 0) or call (k > 0) option theta, -dv/dt
-			inline double theta(const variate::base& v, double f, double sigma, double k, double t, double dt = 1. / 250)
+			// put (k < 0) or call (k > 0) option theta, -dv/dt = -dv/ds sigma/(2 sqrt(t))
+			inline double theta(const variate::base& v, double f, double sigma, double k, double t)
 			{
-				double s = sigma * sqrt(t);
-				double v0 = value(v, f, s, k);
-				s = sigma * sqrt(t - dt);
-				double v_ = value(v, f, s, k);
+				if (!(t > 0)) {
+					return NaN;
+				}
 
-				return (v_ - v0) / dt;
+				return -vega(v, f, sigma * sqrt(t), k) * sigma / (2 * sqrt(t));
 			}
 
-			// implied volatility using initial guess, max number of iterations, and tolerance
-			inline double implied(const variate::base& v, double f, double v0, double k,
-				double s = 0, unsigned n = 0, double tol = 0)
+			// Normalized call value b(x, s) = e^{x/2} N(x/s + s/2) - e^{-x/2} N(x/s - s/2)
+			// for the normal variate where x = log(f/k). The call value is sqrt(f k) b(x, s).
+			inline double normalized_value(double x, double s)
 			{
-				// max(k - f,0) >= k - f
-				// max(k - f,0) <= k
-				if (k < 0) {
-					if (v0 <= std::max(-k - f, 0.) || v0 >= k) {
-						return NaN;
+				double d = x / s;
+
+				return (exp(x / 2) * erfc(-(d + s / 2) / M_SQRT2) - exp(-x / 2) * erfc(-(d - s / 2) / M_SQRT2)) / 2;
+			}
+			// db/ds
+			inline double normalized_vega(double x, double s)
+			{
+				double d = x / s;
+
+				return exp(-(d * d + s * s / 4) / 2) / M_SQRT2PI;
+			}
+
+			// Delbourgo-Gregory rational cubic on [x0, x1] with values y0, y1, slopes d0, d1, and control r > -1.
+			// r = 3 is the cubic Hermite interpolant and large r tends to linear interpolation.
+			inline double rational_cubic(double x, double x0, double x1, double y0, double y1, double d0, double d1, double r)
+			{
+				double h = x1 - x0;
+				if (h == 0) {
+					return (y0 + y1) / 2;
+				}
+
+				double t = (x - x0) / h;
+				if (!(r < 1 / (std::numeric_limits<double>::epsilon() * std::numeric_limits<double>::epsilon()))) {
+					return y0 * (1 - t) + y1 * t;
+				}
+
+				double u = 1 - t;
+
+				return (y1 * t * t * t + (r * y1 - h * d1) * t * t * u + (r * y0 + h * d0) * t * u * u + y0 * u * u * u)
+					/ (1 + (r - 3) * t * u);
+			}
+			// Control r fitting second derivative y2 at x0 (left) or x1, increased if needed to keep the
+			// rational cubic monotone and convex or concave when the data are. If shape is true shape
+			// preservation is preferred over matching y2 when the slopes are degenerate.
+			inline double rational_cubic_control(double x0, double x1, double y0, double y1, double d0, double d1,
+				double y2, bool left, bool shape)
+			{
+				constexpr double r_min = -(1 - 1.4901161193847656e-08); // -(1 - sqrt(eps))
+				const double r_max = 1 / (std::numeric_limits<double>::epsilon() * std::numeric_limits<double>::epsilon());
+				constexpr double tiny = std::numeric_limits<double>::min();
+
+				double h = x1 - x0;
+				double m = (y1 - y0) / h; // secant slope
+				double num = h * y2 / 2 + (d1 - d0);
+				double den = left ? m - d0 : d1 - m;
+				double r = fabs(num) < tiny ? 0 : fabs(den) < tiny ? (num > 0 ? r_max : r_min) : num / den;
+
+				// smallest control preserving shape
+				bool monotone = d0 * m >= 0 && d1 * m >= 0;
+				bool convex = d0 <= m && m <= d1;
+				bool concave = d0 >= m && m >= d1;
+				if (!monotone && !convex && !concave) {
+					return std::max(r, r_min);
+				}
+				double r1 = -std::numeric_limits<double>::max(), r2 = r1;
+				if (monotone) {
+					if (fabs(m) >= tiny) {
+						r1 = (d1 + d0) / m;
+					}
+					else if (shape) {
+						r1 = r_max;
 					}
 				}
-				// max(f - k,0) >= f - k
-				// max(f - k,0) <= f
-				else if (k > 0) {
-					if (v0 <= std::max(f - k, 0.) || v0 >= f) {
-						return NaN;
+				if (convex || concave) {
+					if (fabs(m - d0) >= tiny && fabs(d1 - m) >= tiny) {
+						r2 = std::max(fabs((d1 - d0) / (d1 - m)), fabs((d1 - d0) / (m - d0)));
 					}
+					else if (shape) {
+						r2 = r_max;
+					}
+				}
+				else if (monotone && shape) {
+					r2 = r_max;
 				}
 
-				if (s == 0) {
-					s = 0.1; // initial vol guess
+				return std::max(r, std::max(r_min, std::max(r1, r2)));
+			}
+
+			// Initial guess for s given out-of-the-money value p on (f, k) for the normal variate
+			// following Jaeckel's "Let's be rational". With x = -|log(f/k)| and beta = p/sqrt(f k) in
+			// (0, e^{x/2}) the inflection point s_c = sqrt(2|x|) of b(x, s) and the points s_l and s_u
+			// where its tangent crosses 0 and e^{x/2} split beta into four branches. The inner branches
+			// interpolate s(beta) by rational cubics matching b and vega at the ends. The outer branches
+			// interpolate maps of beta given by the asymptotics of b as s -> 0 and s -> infinity
+			//	f_l(s) = 2 pi |x|/sqrt(27) N(-|x|/(sqrt(3) s))^3, f_u(s) = N(-s/2)
+			// that have closed form inverses. The relative error is below 0.1 and mostly below 0.003.
+			inline double implied_guess(double f, double p, double k)
+			{
+				constexpr double pi = 3.14159265358979323846;
+				constexpr double sqrt3 = 1.73205080756887729353;
+				constexpr double c_l = 2 * pi / (3 * sqrt3); // 2 pi/sqrt(27)
+
+				double x = -fabs(log(f / k));
+				double beta = p / sqrt(f * k);
+				double b_max = exp(x / 2);
+				if (!(0 < beta && beta < b_max)) {
+					return NaN;
 				}
-				if (n == 0) {
-					n = 100; // maximum number of iterations
+				if (x == 0) {
+					// b(0, s) = 1 - 2 N(-s/2)
+					return -2 * normal::N_inv((1 - beta) / 2);
 				}
-				if (tol == 0) {
-					tol = sqrt(std::numeric_limits<double>::epsilon()); // absolute tolerance
+
+				double s_c = sqrt(-2 * x), b_c = normalized_value(x, s_c), v_c = normalized_vega(x, s_c);
+				if (beta < b_c) {
+					double s_l = s_c - b_c / v_c, b_l = normalized_value(x, s_l);
+					if (beta < b_l) {
+						// f_l(s(beta)) has slope 1 at beta = 0
+						double z = -x / (sqrt3 * s_l), y = z * z;
+						double P = normal::N(-z), phi = normal::N(z, 1);
+						double f_l = c_l * -x * P * P * P;
+						double f1 = 2 * pi * y * P * P * exp(y + s_l * s_l / 8);
+						double f2 = pi / 6 * y / (s_l * s_l * s_l) * P
+							* (8 * sqrt3 * s_l * -x + (3 * s_l * s_l * (s_l * s_l - 8) - 8 * x * x) * P / phi)
+							* exp(2 * y + s_l * s_l / 4);
+						double r = rational_cubic_control(0, b_l, 0, f_l, 1, f1, f2, false, true);
+						double g = rational_cubic(beta, 0, b_l, 0, f_l, 1, f1, r);
+						if (!(g > 0)) {
+							// quadratic with g(0) = 0, g'(0) = 1, and g(b_l) = f_l
+							double t = beta / b_l;
+							g = (f_l * t + b_l * (1 - t)) * t;
+						}
+
+						return x / (sqrt3 * normal::N_inv(cbrt(g / (c_l * -x))));
+					}
+
+					double v_l = normalized_vega(x, s_l);
+					double r = rational_cubic_control(b_l, b_c, s_l, s_c, 1 / v_l, 1 / v_c, 0, false, false);
+
+					return rational_cubic(beta, b_l, b_c, s_l, s_c, 1 / v_l, 1 / v_c, r);
 				}
 
-				double v_ = value(v, f, s, k);
-				double dv_ = vega(v, f, s, k); // dv/ds
-				double s_ = s - (v_ - v0) / dv_; // Newton-Raphson
-				if (s_ < 0) {
-					s_ = s / 2;
+				double s_u = s_c + (b_max - b_c) / v_c, b_u = normalized_value(x, s_u);
+				if (beta <= b_u) {
+					double v_u = normalized_vega(x, s_u);
+					double r = rational_cubic_control(b_c, b_u, s_c, s_u, 1 / v_c, 1 / v_u, 0, true, false);
+
+					return rational_cubic(beta, b_c, b_u, s_c, s_u, 1 / v_c, 1 / v_u, r);
 				}
-				while (fabs(s_ - s) > tol) {
-					v_ = value(v, f, s_, k);
-					dv_ = vega(v, f, s_, k);
-					s = s_ - (v_ - v0) / dv_;
-					if (s < 0) {
-						s = s_ / 2;
+
+				// f_u(s(beta)) has slope -1/2 at beta = b_max
+				double w = x * x / (s_u * s_u);
+				double f_u = normal::N(-s_u / 2);
+				double f1 = -exp(w / 2) / 2;
+				double f2 = sqrt(pi / 2) * exp(w + s_u * s_u / 8) * w / s_u;
+				double g = 0;
+				if (std::isfinite(f2)) {
+					double r = rational_cubic_control(b_u, b_max, f_u, 0, f1, -0.5, f2, true, true);
+					g = rational_cubic(beta, b_u, b_max, f_u, 0, f1, -0.5, r);
+				}
+				if (!(g > 0)) {
+					double h = b_max - b_u, t = (beta - b_u) / h;
+					g = (f_u * (1 - t) + h * t / 2) * (1 - t);
+				}
+
+				return -2 * normal::N_inv(g);
+			}
+
+			// Implied volatility using initial guess, max number of iterations, and tolerance.
+			// Solve log p(s) = log p0 for the out-of-the-money value p using third order Householder
+			// steps, or Halley steps if the third derivative is not finite, safeguarded by bisection.
+			// Working with log values keeps the iteration well scaled for far out-of-the-money options
+			// where values are tiny. The default guess is within ten percent for
+			// the normal variate so one or two valuations reach machine precision.
+			// value(s, ko) is the value with out-of-the-money strike ko, 0 on underflow, or NaN if s
+			// is outside the domain, and dlog(s, ko, p) returns { g', g'', g''' } for g = log p.
+			// Return NaN and set status if the value is outside the no arbitrage bounds
+			// or the iteration does not converge.
+			template<class Value, class Dlog>
+			inline double implied_solve(Value&& value, Dlog&& dlog, double f, double v0, double k,
+				double s, unsigned n, double tol, implied_status* status)
+			{
+				implied_status status_;
+				if (!status) {
+					status = &status_;
+				}
+
+				if (!(f > 0) || k == 0 || !std::isfinite(f) || !std::isfinite(k) || !std::isfinite(v0)) {
+					*status = IMPLIED_INVALID;
+
+					return NaN;
+				}
+				// max(-k - f,0) < p < -k
+				// max(f - k,0) < c < f
+				double intrinsic = k < 0 ? std::max(-k - f, 0.) : std::max(f - k, 0.);
+				if (v0 <= intrinsic) {
+					*status = IMPLIED_BELOW_INTRINSIC;
+
+					return NaN;
+				}
+				if (v0 >= (k < 0 ? -k : f)) {
+					*status = IMPLIED_ABOVE_MAXIMUM;
+
+					return NaN;
+				}
+
+				// out-of-the-money option using put-call parity
+				double k_ = fabs(k);
+				double ko = k_ >= f ? k_ : -k_;
+				double p0 = v0 - intrinsic;
+				if (!(p0 > 0)) {
+					*status = IMPLIED_BELOW_INTRINSIC;
+
+					return NaN;
+				}
+
+				if (s <= 0) {
+					s = implied_guess(f, p0, k_);
+					if (!(s > 0)) {
+						s = 0.1;
 					}
-					std::swap(s_, s);
-					if (n == 0) {
-						return NaN;
+				}
+				if (n == 0) {
+					n = 100; // maximum number of iterations
+				}
+
+				constexpr double eps = std::numeric_limits<double>::epsilon();
+
+				double logp0 = log(p0);
+				double lo = 0, hi = std::numeric_limits<double>::infinity(); // bracket
+				double ds_ = hi; // previous step
+				while (n--) {
+					double p = value(s, ko);
+					if (!(p > 0)) {
+						// underflow or s outside the domain of the cumulant
+						(p == 0 ? lo : hi) = s;
+						s = std::isfinite(hi) ? (lo + hi) / 2 : 2 * s;
+
+						continue;
+					}
+
+					double g = log(p) - logp0;
+					if (g == 0) {
+						*status = IMPLIED_OK;
+
+						return s;
+					}
+					// default tolerance is relative to the current iterate
+					double tol_ = tol ? tol : 4 * eps * s;
+					(g < 0 ? lo : hi) = s;
+					if (hi - lo <= tol_) {
+						*status = IMPLIED_OK;
+
+						return s;
+					}
+
+					auto [g1, g2, g3] = dlog(s, ko, p);
+					double nu = -g / g1; // Newton
+					double h2 = nu * g2 / g1;
+					double h3 = nu * nu * g3 / g1;
+					double ds = nu;
+					// third order Householder converges quartically, Halley cubically
+					unsigned order = 2;
+					double h = (1 + h2 / 2) / (1 + h2 + h3 / 6);
+					if (std::isfinite(h) && 0.5 < h && h < 2) {
+						ds *= h;
+						order = 4;
+					}
+					else if (1 + h2 / 2 > 0.5) {
+						ds /= 1 + h2 / 2;
+						order = 3;
+					}
+
+					double s_ = s + ds;
+					if (!(lo < s_ && s_ < hi)) {
+						s_ = std::isfinite(hi) ? (lo + hi) / 2 : 2 * s;
+						order = 1;
+					}
+					// steps that stop shrinking near the root are roundoff in p
+					// and the error after a step of relative size e is about e^order
+					ds = s_ - s;
+					if (fabs(ds) <= tol_ || (fabs(ds) < sqrt(eps) * s && fabs(ds) >= fabs(ds_) / 2)
+						|| (!tol && order > 2 && pow(fabs(ds) / s, order) <= eps / 16)) {
+						*status = IMPLIED_OK;
+
+						return s_;
 					}
-					--n;
+					ds_ = ds;
+					s = s_;
 				}
 
-				return s_;
+				*status = IMPLIED_NO_CONVERGENCE;
+
+				return NaN;
+			}
+
+			// Implied volatility for the normal variate using closed form values and derivatives
+			// p = sqrt(f k) b(x, s) with x = -|log(f/k)| so there are no virtual calls.
+			// Same arguments as implied.
+			inline double implied_normal(double f, double v0, double k,
+				double s = 0, unsigned n = 0, double tol = 0, implied_status* status = nullptr)
+			{
+				auto value_ = [f](double s, double ko) {
+					double x = -fabs(log(f / fabs(ko)));
+
+					return sqrt(f * fabs(ko)) * normalized_value(x, s);
+				};
+				// b' = normalized_vega, b''/b' = a = x^2/s^3 - s/4, b'''/b' = a^2 + a'
+				auto dlog = [f](double s, double ko, double p) {
+					double x = -fabs(log(f / fabs(ko)));
+					double g1 = sqrt(f * fabs(ko)) * normalized_vega(x, s) / p;
+					double a = x * x / (s * s * s) - s / 4;
+					double a1 = -3 * x * x / (s * s * s * s) - 0.25;
+
+					return std::array<double, 3>{ g1, g1 * (a - g1), g1 * (a * a + a1 - 3 * g1 * a + 2 * g1 * g1) };
+				};
+
+				return implied_solve(value_, dlog, f, v0, k, s, n, tol, status);
+			}
+
+			// Implied volatility of value v0 on forward f with strike k for variate v
+			// using optional initial guess, max number of iterations, and tolerance.
+			// The normal variate uses implied_normal.
+			inline double implied(const variate::base& v, double f, double v0, double k,
+				double s = 0, unsigned n = 0, double tol = 0, implied_status* status = nullptr)
+			{
+				if (typeid(v) == typeid(variate::normal)) {
+					return implied_normal(f, v0, k, s, n, tol, status);
+				}
+
+				auto value_ = [&v, f](double s, double ko) {
+					double p = value(v, f, s, ko);
+
+					return p == 0 && !std::isfinite(v.cumulant(s)) ? NaN : p;
+				};
+				// dp/ds, d^2p/ds^2, and d^3p/ds^3 at fixed k where dx/ds = (kappa'(s) - x)/s
+				auto dlog = [&v, f](double s, double ko, double p) {
+					double x = moneyness(v, f, s, fabs(ko));
+					double x1 = (v.cumulant(s, 1) - x) / s;
+					double x2 = (v.cumulant(s, 2) - 2 * x1) / s;
+					double c11 = v.cdf(x, s, 1, 1);
+					double p1 = -f * v.cdf(x, s, 0, 1);
+					double p2 = -f * (c11 * x1 + v.cdf(x, s, 0, 2));
+					double p3 = -f * ((v.cdf(x, s, 2, 1) * x1 + 2 * v.cdf(x, s, 1, 2)) * x1 + c11 * x2 + v.cdf(x, s, 0, 3));
+					double g1 = p1 / p;
+
+					return std::array<double, 3>{ g1, p2 / p - g1 * g1, p3 / p - 3 * g1 * (p2 / p) + 2 * g1 * g1 * g1 };
+				};
+
+				return implied_solve(value_, dlog, f, v0, k, s, n, tol, status);
 			}
 
 			// Var((k - F)^+) = E[(k - F)^2 1(F <= k)] - E[(k - F) 1(F <= k)]^2
@@ -230,10 +570,11 @@ namespace fms {
 		namespace digital {
 
 			// q = P(F <= -k), k < 0, or d = P(F > k), k > 0
-			inline double value(const variate::base& v, double f, double s, double k)
+			template<class X = double>
+			inline X value(const variate::base& v, X f, X s, X k)
 			{
-				double x = moneyness(v, f, s, fabs(k));
-				double v0 = v.cdf(x, 0);
+				X x = moneyness(v, f, s, fabs(k));
+				X v0 = cdf(v, x, X(0));
 
 				if (k < 0) {
 					return v0;
@@ -244,11 +585,16 @@ namespace fms {
 
 				return signbit(k) ? 0 : 1;
 			}
+			inline double value(const variate::base& v, double f, double s, double k)
+			{
+				return value<double>(v, f, s, k);
+			}
 			// dq/df or dd/df
-			inline double delta(const variate::base& v, double f, double s, double k)
+			template<class X = double>
+			inline X delta(const variate::base& v, X f, X s, X k)
 			{
-				double x = moneyness(v, f, s, fabs(k));
-				double v0 = -v.cdf(x, 0, 1) / (f * s);
+				X x = moneyness(v, f, s, fabs(k));
+				X v0 = -cdf(v, x, X(0), 1) / (f * s);
 
 				if (k < 0) {
 					return v0;
@@ -259,6 +605,10 @@ namespace fms {
 
 				return 0;
 			}
+			inline double delta(const variate::base& v, double f, double s, double k)
+			{
+				return delta<double>(v, f, s, k);
+			}
 			// d^2q/df^2 or d^d/df^2
 			inline double gamma(const variate::base& v, double f, double s, double k)
 			{
@@ -289,80 +639,339 @@ namespace fms {
 
 				return 0;
 			}
+			// -dq/dt or -dd/dt
+			inline double theta(const variate::base& v, double f, double sigma, double k, double t)
+			{
+				if (!(t > 0)) {
+					return NaN;
+				}
+
+				return -vega(v, f, sigma * sqrt(t), k) * sigma / (2 * sqrt(t));
+			}
 		}
 
 		namespace bsm {
 
 			// Convert B-S/M parameters to Black forward parameters.
-			inline auto Dfs(double r, double S, double sigma, double t)
+			template<class X = double>
+			inline auto Dfs(X r, X S, X sigma, X t)
 			{
 				if (t == 0) {
 					t = 1;
 				}
-				double D = exp(-r * t);
-				double f = S / D;
-				double s = sigma * sqrt(t);
+				X D = exp(-r * t);
+				X f = S / D;
+				X s = sigma * sqrt(t);
 
 				return std::tuple(D, f, s);
 			}
+			inline auto Dfs(double r, double S, double sigma, double t)
+			{
+				return Dfs<double>(r, S, sigma, t);
+			}
 
-			inline double moneyness(const variate::base& v, double r, double S, double sigma, double k, double t)
+			template<class X = double>
+			inline X moneyness(const variate::base& v, X r, X S, X sigma, X k, X t)
 			{
 				auto [D, f, s] = Dfs(r, S, sigma, t);
 
 				return option::moneyness(v, f, s, fabs(k));
 			}
+			inline double moneyness(const variate::base& v, double r, double S, double sigma, double k, double t)
+			{
+				return moneyness<double>(v, r, S, sigma, k, t);
+			}
 
-			inline double value(const variate::base& v, double r, double S, double sigma, int c, double k, double t)
+			// Parameters shared by every strike of an expiry.
+			// D, f, s, kappa(s), and log(f) are computed once so each strike costs
+			// one log for moneyness plus the cdf calls of the greek.
+			// Contract C is known at compile time so a loop over strikes has no branch
+			// on the contract or the sign of the strike. Strike k > 0.
+			// Invalid contracts return NaN.
+			template<class X = double>
+			class expiry {
+				const variate::base* v;
+				X r, sigma, t;
+				X D, f, s, kappa, logf;
+			public:
+				expiry(const variate::base& v, X r, X S, X sigma, X t)
+					: v(&v), r(r), sigma(sigma), t(t)
+				{
+					std::tie(D, f, s) = Dfs(r, S, sigma, t);
+					kappa = cumulant(v, s);
+					logf = f > 0 && s > 0 ? log(f) : X(NaN);
+				}
+
+				X discount() const
+				{
+					return D;
+				}
+				X forward() const
+				{
+					return f;
+				}
+				X stdev() const
+				{
+					return s;
+				}
+
+				// same expiry with forward f m, e.g. after a relative spot shock m - 1
+				expiry spot(X m) const
+				{
+					expiry e(*this);
+					e.f *= m;
+					e.logf += log(m);
+
+					return e;
+				}
+
+				// (log(k/f) + kappa(s))/s
+				X moneyness(X k) const
+				{
+					return k > 0 ? (log(k) - logf + kappa) / s : X(NaN);
+				}
+
+				template<contract C>
+				X value(X k) const
+				{
+					X x = moneyness(k);
+
+					if constexpr (C == contract::PUT) {
+						return D * (k * cdf(*v, x, X(0)) - f * cdf(*v, x, s));
+					}
+					else if constexpr (C == contract::CALL) {
+						return D * (f * (1 - cdf(*v, x, s)) - k * (1 - cdf(*v, x, X(0))));
+					}
+					else if constexpr (C == contract::DIGITAL_PUT) {
+						return D * cdf(*v, x, X(0));
+					}
+					else if constexpr (C == contract::DIGITAL_CALL) {
+						return D * (1 - cdf(*v, x, X(0)));
+					}
+					else {
+						return X(NaN);
+					}
+				}
+
+				template<contract C>
+				X delta(X k) const
+				{
+					X x = moneyness(k);
+
+					if constexpr (C == contract::PUT) {
+						return -cdf(*v, x, s);
+					}
+					else if constexpr (C == contract::CALL) {
+						return 1 - cdf(*v, x, s);
+					}
+					else if constexpr (C == contract::DIGITAL_PUT) {
+						return -cdf(*v, x, X(0), 1) / (f * s);
+					}
+					else if constexpr (C == contract::DIGITAL_CALL) {
+						return cdf(*v, x, X(0), 1) / (f * s);
+					}
+					else {
+						return X(NaN);
+					}
+				}
+
+				template<contract C>
+				double gamma(double k) const
+				{
+					double x = moneyness(k);
+
+					if constexpr (C == contract::PUT || C == contract::CALL) {
+						return v->cdf(x, s, 1, 0) / (f * s * D);
+					}
+					else if constexpr (C == contract::DIGITAL_PUT || C == contract::DIGITAL_CALL) {
+						double g = (s * v->cdf(x, 0, 1) + v->cdf(x, 0, 2)) / (f * f * s * s * D);
+
+						return C == contract::DIGITAL_PUT ? g : -g;
+					}
+					else {
+						return NaN;
+					}
+				}
+
+				template<contract C>
+				double vega(double k) const
+				{
+					double x = moneyness(k);
+
+					if constexpr (C == contract::PUT || C == contract::CALL) {
+						return -f * v->cdf(x, s, 0, 1) * D * sqrt(t);
+					}
+					else if constexpr (C == contract::DIGITAL_PUT || C == contract::DIGITAL_CALL) {
+						double g = v->cdf(x, 0, 1) * (v->cumulant(s, 1) - x) / s * D * sqrt(t);
+
+						return C == contract::DIGITAL_PUT ? g : -g;
+					}
+					else {
+						return NaN;
+					}
+				}
+
+				// theta, -dv/dt, for v = D b(f, s) with D = e^{-r t}, f = S/D, s = sigma sqrt(t)
+				// -dv/dt = r v - D (r f db/df + db/ds sigma/(2 sqrt(t)))
+				template<contract C>
+				double theta(double k) const
+				{
+					if (!(t > 0)) {
+						return NaN;
+					}
+
+					double x = moneyness(k);
+					double ds = sigma / (2 * sqrt(t)); // ds/dt
+
+					if constexpr (C == contract::PUT || C == contract::CALL) {
+						// put value terms in f cancel with delta
+						double p = D * (r * k * v->cdf(x, 0) + f * v->cdf(x, s, 0, 1) * ds);
+
+						// c = p + S - D k
+						return C == contract::PUT ? p : p - r * D * k;
+					}
+					else if constexpr (C == contract::DIGITAL_PUT || C == contract::DIGITAL_CALL) {
+						double p = v->cdf(x, 0, 1);
+						double q = D * (r * v->cdf(x, 0) + p * (r - (v->cumulant(s, 1) - x) * ds) / s);
+
+						// d = D - q
+						return C == contract::DIGITAL_PUT ? q : r * D - q;
+					}
+					else {
+						return NaN;
+					}
+				}
+
+				// y[i] = value of contract C at strike k[i]
+				template<contract C>
+				void value(size_t n, const X* k, X* y) const
+				{
+					for (size_t i = 0; i < n; ++i) {
+						y[i] = value<C>(k[i]);
+					}
+				}
+				template<contract C>
+				void delta(size_t n, const X* k, X* y) const
+				{
+					for (size_t i = 0; i < n; ++i) {
+						y[i] = delta<C>(k[i]);
+					}
+				}
+				template<contract C>
+				void gamma(size_t n, const double* k, double* y) const
+				{
+					for (size_t i = 0; i < n; ++i) {
+						y[i] = gamma<C>(k[i]);
+					}
+				}
+				template<contract C>
+				void vega(size_t n, const double* k, double* y) const
+				{
+					for (size_t i = 0; i < n; ++i) {
+						y[i] = vega<C>(k[i]);
+					}
+				}
+				template<contract C>
+				void theta(size_t n, const double* k, double* y) const
+				{
+					for (size_t i = 0; i < n; ++i) {
+						y[i] = theta<C>(k[i]);
+					}
+				}
+			};
+
+			// Single strike using an expiry.
+			template<contract C, class X = double>
+			inline X value(const variate::base& v, X r, X S, X sigma, X k, X t)
 			{
-				auto [D, f, s] = Dfs(r, S, sigma, t);
+				return expiry<X>(v, r, S, sigma, t).template value<C>(k);
+			}
+			template<contract C>
+			inline double value(const variate::base& v, double r, double S, double sigma, double k, double t)
+			{
+				return value<C, double>(v, r, S, sigma, k, t);
+			}
+			template<contract C, class X = double>
+			inline X delta(const variate::base& v, X r, X S, X sigma, X k, X t)
+			{
+				return expiry<X>(v, r, S, sigma, t).template delta<C>(k);
+			}
+			template<contract C>
+			inline double delta(const variate::base& v, double r, double S, double sigma, double k, double t)
+			{
+				return delta<C, double>(v, r, S, sigma, k, t);
+			}
+			template<contract C>
+			inline double gamma(const variate::base& v, double r, double S, double sigma, double k, double t)
+			{
+				return expiry<>(v, r, S, sigma, t).gamma<C>(k);
+			}
+			template<contract C>
+			inline double vega(const variate::base& v, double r, double S, double sigma, double k, double t)
+			{
+				return expiry<>(v, r, S, sigma, t).vega<C>(k);
+			}
+			template<contract C>
+			inline double theta(const variate::base& v, double r, double S, double sigma, double k, double t)
+			{
+				return expiry<>(v, r, S, sigma, t).theta<C>(k);
+			}
 
+			// Contract c from option::contract at run time.
+			template<class X = double>
+			inline X value(const variate::base& v, X r, X S, X sigma, int c, X k, X t)
+			{
 				switch (c) {
 				case option::contract::PUT:
-					return D * black::value(v, f, s, -k);
+					return value<contract::PUT, X>(v, r, S, sigma, k, t);
 				case option::contract::CALL:
-					return D * black::value(v, f, s, k);
+					return value<contract::CALL, X>(v, r, S, sigma, k, t);
 				case option::contract::DIGITAL_PUT:
-					return D * digital::value(v, f, s, -k);
+					return value<contract::DIGITAL_PUT, X>(v, r, S, sigma, k, t);
 				case option::contract::DIGITAL_CALL:
-					return D * digital::value(v, f, s, k);
+					return value<contract::DIGITAL_CALL, X>(v, r, S, sigma, k, t);
 				}
 
 				return NaN;
 			}
+			inline double value(const variate::base& v, double r, double S, double sigma, int c, double k, double t)
+			{
+				return value<double>(v, r, S, sigma, c, k, t);
+			}
 
 			// delta
-			inline double delta(const variate::base& v, double r, double S, double sigma, int c, double k, double t)
+			template<class X = double>
+			inline X delta(const variate::base& v, X r, X S, X sigma, int c, X k, X t)
 			{
-				auto [D, f, s] = Dfs(r, S, sigma, t);
-
 				switch (c) {
 				case option::contract::PUT:
-					return black::delta(v, f, s, -k);
+					return delta<contract::PUT, X>(v, r, S, sigma, k, t);
 				case option::contract::CALL:
-					return black::delta(v, f, s, k);
+					return delta<contract::CALL, X>(v, r, S, sigma, k, t);
 				case option::contract::DIGITAL_PUT:
-					return digital::delta(v, f, s, -k);
+					return delta<contract::DIGITAL_PUT, X>(v, r, S, sigma, k, t);
 				case option::contract::DIGITAL_CALL:
-					return digital::delta(v, f, s, k);
+					return delta<contract::DIGITAL_CALL, X>(v, r, S, sigma, k, t);
 				}
 
 				return NaN;
 			}
+			inline double delta(const variate::base& v, double r, double S, double sigma, int c, double k, double t)
+			{
+				return delta<double>(v, r, S, sigma, c, k, t);
+			}
 			// gamma
 			inline double gamma(const variate::base& v, double r, double S, double sigma, int c, double k, double t)
 			{
-				auto [D, f, s] = Dfs(r, S, sigma, t);
-
 				switch (c) {
 				case option::contract::PUT:
-					return black::gamma(v, f, s, -k) / D;
+					return gamma<contract::PUT>(v, r, S, sigma, k, t);
 				case option::contract::CALL:
-					return black::gamma(v, f, s, k) / D;
+					return gamma<contract::CALL>(v, r, S, sigma, k, t);
 				case option::contract::DIGITAL_PUT:
-					return digital::gamma(v, f, s, -k) / D;
+					return gamma<contract::DIGITAL_PUT>(v, r, S, sigma, k, t);
 				case option::contract::DIGITAL_CALL:
-					return digital::gamma(v, f, s, k) / D;
+					return gamma<contract::DIGITAL_CALL>(v, r, S, sigma, k, t);
 				}
 
 				return NaN;
@@ -370,29 +979,111 @@ namespace fms {
 			// vega
 			inline double vega(const variate::base& v, double r, double S, double sigma, int c, double k, double t)
 			{
-				auto [D, f, s] = Dfs(r, S, sigma, t);
+				switch (c) {
+				case option::contract::PUT:
+					return vega<contract::PUT>(v, r, S, sigma, k, t);
+				case option::contract::CALL:
+					return vega<contract::CALL>(v, r, S, sigma, k, t);
+				case option::contract::DIGITAL_PUT:
+					return vega<contract::DIGITAL_PUT>(v, r, S, sigma, k, t);
+				case option::contract::DIGITAL_CALL:
+					return vega<contract::DIGITAL_CALL>(v, r, S, sigma, k, t);
+				}
 
+				return NaN;
+			}
+			// theta
+			inline double theta(const variate::base& v, double r, double S, double sigma, int c, double k, double t)
+			{
 				switch (c) {
 				case option::contract::PUT:
-					return black::vega(v, f, s, -k) * D * sqrt(t);
+					return theta<contract::PUT>(v, r, S, sigma, k, t);
 				case option::contract::CALL:
-					return black::vega(v, f, s, k) * D * sqrt(t);
+					return theta<contract::CALL>(v, r, S, sigma, k, t);
 				case option::contract::DIGITAL_PUT:
-					return digital::vega(v, f, s, -k) * D * sqrt(t);
+					return theta<contract::DIGITAL_PUT>(v, r, S, sigma, k, t);
 				case option::contract::DIGITAL_CALL:
-					return digital::vega(v, f, s, k) * D * sqrt(t);
+					return theta<contract::DIGITAL_CALL>(v, r, S, sigma, k, t);
 				}
 
 				return NaN;
 			}
 
-			// put (k < 0) or call (k > 0) option theta, -dv/dt
-			inline double theta(const variate::base& v, double r, double S, double sigma, int c, double k, double t, double dt = 1. / 250)
+			// Call g(std::integral_constant<contract, C>{}, i, j) for each run [i, j) of equal c[i].
+			// Books sorted by contract have one run per contract type.
+			template<class G>
+			inline void for_each_contract(size_t n, const int* c, G&& g)
 			{
-				double v0 = value(v, r, S, sigma, c, k, t);
-				double v_ = value(v, r, S, sigma, c, k, t - dt);
+				using std::integral_constant;
+
+				for (size_t i = 0, j; i < n; i = j) {
+					for (j = i + 1; j < n && c[j] == c[i]; ++j)
+						;
+
+					switch (c[i]) {
+					case option::contract::PUT:
+						g(integral_constant<contract, contract::PUT>{}, i, j);
+						break;
+					case option::contract::CALL:
+						g(integral_constant<contract, contract::CALL>{}, i, j);
+						break;
+					case option::contract::DIGITAL_PUT:
+						g(integral_constant<contract, contract::DIGITAL_PUT>{}, i, j);
+						break;
+					case option::contract::DIGITAL_CALL:
+						g(integral_constant<contract, contract::DIGITAL_CALL>{}, i, j);
+						break;
+					default:
+						g(integral_constant<contract, contract{}>{}, i, j);
+					}
+				}
+			}
 
-				return (v_ - v0) / dt;
+			// Value and greeks of n positions with contracts c[i] put in y[i].
+			inline void value(const variate::base& v, size_t n, const int* c,
+				const double* r, const double* S, const double* sigma, const double* k, const double* t, double* y)
+			{
+				for_each_contract(n, c, [&](auto C, size_t i, size_t j) {
+					for (; i < j; ++i) {
+						y[i] = value<decltype(C)::value>(v, r[i], S[i], sigma[i], k[i], t[i]);
+					}
+				});
+			}
+			inline void delta(const variate::base& v, size_t n, const int* c,
+				const double* r, const double* S, const double* sigma, const double* k, const double* t, double* y)
+			{
+				for_each_contract(n, c, [&](auto C, size_t i, size_t j) {
+					for (; i < j; ++i) {
+						y[i] = delta<decltype(C)::value>(v, r[i], S[i], sigma[i], k[i], t[i]);
+					}
+				});
+			}
+			inline void gamma(const variate::base& v, size_t n, const int* c,
+				const double* r, const double* S, const double* sigma, const double* k, const double* t, double* y)
+			{
+				for_each_contract(n, c, [&](auto C, size_t i, size_t j) {
+					for (; i < j; ++i) {
+						y[i] = gamma<decltype(C)::value>(v, r[i], S[i], sigma[i], k[i], t[i]);
+					}
+				});
+			}
+			inline void vega(const variate::base& v, size_t n, const int* c,
+				const double* r, const double* S, const double* sigma, const double* k, const double* t, double* y)
+			{
+				for_each_contract(n, c, [&](auto C, size_t i, size_t j) {
+					for (; i < j; ++i) {
+						y[i] = vega<decltype(C)::value>(v, r[i], S[i], sigma[i], k[i], t[i]);
+					}
+				});
+			}
+			inline void theta(const variate::base& v, size_t n, const int* c,
+				const double* r, const double* S, const double* sigma, const double* k, const double* t, double* y)
+			{
+				for_each_contract(n, c, [&](auto C, size_t i, size_t j) {
+					for (; i < j; ++i) {
+						y[i] = theta<decltype(C)::value>(v, r[i], S[i], sigma[i], k[i], t[i]);
+					}
+				});
 			}
 			// variance
 			inline double variance(const variate::base& v, double r, double S, double sigma, int c, double k, double t)
@@ -4,9 +4,13 @@
 #include <cassert>
 #include <algorithm>
 #include <random>
+#include <vector>
 #include "fms_derivative.h"
 #include "fms_monte_carlo.h"
 #include "fms_option.h"
+#include "fms_option_implied.h"
+#include "fms_option_portfolio.h"
+#include "fms_option_var.h"
 #include "fms_variate_normal.h"
 
 using namespace fms;
@@ -222,26 +226,450 @@ int option_implied_test()
 
 	for (double f : fs)
 	{
-		for (double k : ks) //!!! test both k and -k
+		for (double k : ks)
 		{
 			for (double s : ss)
 			{
-				auto v = option::black::value(N, f, s, k);
-				auto s0 = option::black::implied(N, f, v, k, s);
-	
-				assert(fabs(s - s0) <= s*sqrt(eps));
+				for (double k_ : { k, -k }) {
+					auto v = option::black::value(N, f, s, k_);
+					double intrinsic = k_ < 0 ? std::max(-k_ - f, 0.) : std::max(f - k_, 0.);
+					implied_status status;
+					auto s0 = option::black::implied(N, f, v, k_, 0, 0, 0, &status);
+					if (v - intrinsic > 1e-8 * f) {
+						assert(status == IMPLIED_OK);
+						assert(fabs(s - s0) <= s * sqrt(eps));
+					}
+					else {
+						// no time value left to invert
+						assert(status == IMPLIED_OK || status == IMPLIED_BELOW_INTRINSIC);
+					}
+				}
+			}
+		}
+	}
+	{
+		implied_status status;
+		assert(std::isnan(option::black::implied(N, 100, 10, 0, 0, 0, 0, &status)));
+		assert(status == IMPLIED_INVALID);
+		assert(std::isnan(option::black::implied(N, 100, 4, 95, 0, 0, 0, &status)));
+		assert(status == IMPLIED_BELOW_INTRINSIC);
+		assert(std::isnan(option::black::implied(N, 100, 100, 95, 0, 0, 0, &status)));
+		assert(status == IMPLIED_ABOVE_MAXIMUM);
+		// put value is bounded by the strike, not the forward
+		assert(std::isnan(option::black::implied(N, 100, 95, -95, 0, 0, 0, &status)));
+		assert(status == IMPLIED_ABOVE_MAXIMUM);
+		assert(std::isnan(option::black::implied(N, 100, 10, 100, 0.2, 1, 0, &status)));
+		assert(status == IMPLIED_NO_CONVERGENCE);
+	}
+
+	return 0;
+}
+
+// normal variate counting valuations
+struct normal_count : public variate::normal {
+	mutable unsigned n = 0;
+
+	double _cdf(double x, double s, unsigned nx, unsigned ns) const override
+	{
+		n += (s != 0 && nx == 0 && ns == 0);
+
+		return variate::normal::_cdf(x, s, nx, ns);
+	}
+};
+
+int option_implied_iteration_test()
+{
+	normal_count M;
+	double f = 100;
+
+	// strikes from f e^{-3} to f e^3
+	for (int i = -60; i <= 60; ++i) {
+		double k = f * exp(-0.05 * i);
+		for (double s : { 0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1., 2., 3. }) {
+			for (double k_ : { k, -k }) {
+				double v = option::black::value(N, f, s, k_);
+				double intrinsic = k_ < 0 ? std::max(-k_ - f, 0.) : std::max(f - k_, 0.);
+				if (!(v - intrinsic > 1e-8 * f)) {
+					continue;
+				}
+
+				implied_status status;
+				M.n = 0;
+				double s0 = option::black::implied(M, f, v, k_, 0, 0, 0, &status);
+				assert(status == IMPLIED_OK);
+				assert(M.n <= 2);
+				assert(fabs(option::black::value(N, f, s0, k_) - v) <= 16 * std::numeric_limits<double>::epsilon() * std::max(f, k));
+				// closed form path for the normal variate
+				double s1 = option::black::implied(N, f, v, k_, 0, 0, 0, &status);
+				assert(status == IMPLIED_OK);
+				assert(fabs(option::black::value(N, f, s1, k_) - v) <= 16 * std::numeric_limits<double>::epsilon() * std::max(f, k));
+			}
+		}
+	}
+
+	return 0;
+}
+
+int option_implied_chain_test()
+{
+	// quotes across strikes and forwards with some bad prices
+	std::vector<double> f, v, k, s;
+	for (double f_ : fs) {
+		for (double k_ : ks) {
+			for (double s_ : { .1, .2, .3 }) {
+				for (double k__ : { k_, -k_ }) {
+					f.push_back(f_);
+					k.push_back(k__);
+					v.push_back(option::black::value(N, f_, s_, k__));
+					s.push_back(s_);
+				}
+			}
+		}
+	}
+	size_t n = f.size();
+	v[0] = -1;
+	v[1] = 2 * f[1];
+
+	for (unsigned threads : { 1u, 4u }) {
+		std::vector<double> s0(n, 0.);
+		std::vector<implied_status> status(n);
+		size_t m = option::black::implied(N, n, f.data(), v.data(), k.data(), s0.data(), status.data(), threads);
+		assert(m == n - 2);
+		assert(status[0] == IMPLIED_BELOW_INTRINSIC && std::isnan(s0[0]));
+		assert(status[1] == IMPLIED_ABOVE_MAXIMUM && std::isnan(s0[1]));
+		for (size_t i = 2; i < n; ++i) {
+			assert(status[i] == IMPLIED_OK);
+			assert(s0[i] == option::black::implied(N, f[i], v[i], k[i]));
+			assert(fabs(s0[i] - s[i]) <= 1e-12);
+		}
+	}
+
+	return 0;
+}
+
+int option_implied_stream_test()
+{
+	double f = 100, s = 0.2;
+	size_t id[] = { 7, 3, 11, 5 };
+	double k[] = { -90, -100, 100, 110 };
+	double v[4], s0[4];
+	for (int i = 0; i < 4; ++i) {
+		v[i] = option::black::value(N, f, s, k[i]);
+	}
+
+	option::black::implied_stream<> is(N);
+	is.update(4, id, std::vector<double>(4, f).data(), v, k, s0);
+	assert(is.size() == 4 && is.solved() == 4);
+	for (int i = 0; i < 4; ++i) {
+		assert(fabs(s0[i] - s) <= 1e-15);
+	}
+
+	// unchanged quotes are not solved again
+	assert(is.update(3, f, v[1], k[1]) == s0[1]);
+	assert(is.solved() == 4);
+
+	// small moves converge from the warm start in at most three iterations
+	option::black::implied_stream<> is2(N, 3);
+	for (int i = 0; i < 4; ++i) {
+		is2.update(id[i], f, v[i], k[i]);
+	}
+	for (double ds : { 0.001, -0.002, 0.0005 }) {
+		for (int i = 0; i < 4; ++i) {
+			double vi = option::black::value(N, f, s + ds, k[i]);
+			implied_status status;
+			double si = is2.update(id[i], f, vi, k[i], &status);
+			assert(status == IMPLIED_OK);
+			assert(fabs(si - (s + ds)) <= 1e-15);
+		}
+	}
+	assert(std::isnan(is2[42]));
+
+	return 0;
+}
+
+int option_strike_test()
+{
+	for (double f : fs) {
+		for (double s : ss) {
+			for (double d : { -0.9, -0.5, -0.1, 0.1, 0.5, 0.9 }) {
+				double k = option::black::strike(N, f, s, d);
+				assert(signbit(k) == signbit(d));
+				assert(fabs(option::black::delta(N, f, s, k) - d) <= 1e-14);
+			}
+		}
+	}
+
+	return 0;
+}
+
+int option_bsm_contract_test()
+{
+	// positions mostly sorted by contract with an invalid contract
+	int c[] = { PUT, PUT, CALL, CALL, CALL, DIGITAL_PUT, DIGITAL_CALL, 'X', PUT };
+	constexpr size_t n = sizeof(c) / sizeof(*c);
+	double r[n], S[n], sigma[n], k[n], t[n];
+	for (size_t i = 0; i < n; ++i) {
+		r[i] = 0.01 * i;
+		S[i] = 100;
+		sigma[i] = 0.1 + 0.02 * i;
+		k[i] = 90 + 3 * i;
+		t[i] = 0.25 + 0.1 * i;
+	}
+
+	double y[5][n];
+	option::bsm::value(N, n, c, r, S, sigma, k, t, y[0]);
+	option::bsm::delta(N, n, c, r, S, sigma, k, t, y[1]);
+	option::bsm::gamma(N, n, c, r, S, sigma, k, t, y[2]);
+	option::bsm::vega(N, n, c, r, S, sigma, k, t, y[3]);
+	option::bsm::theta(N, n, c, r, S, sigma, k, t, y[4]);
+	for (size_t i = 0; i < n; ++i) {
+		if (c[i] == 'X') {
+			for (size_t j = 0; j < 5; ++j) {
+				assert(std::isnan(y[j][i]));
 			}
+
+			continue;
+		}
+
+		// Black forward values with signed strikes
+		double D = exp(-r[i] * t[i]), f = S[i] / D, s = sigma[i] * sqrt(t[i]);
+		bool digital = c[i] == DIGITAL_PUT || c[i] == DIGITAL_CALL;
+		double k_ = c[i] == PUT || c[i] == DIGITAL_PUT ? -k[i] : k[i];
+		double v = digital ? option::digital::value(N, f, s, k_) : option::black::value(N, f, s, k_);
+		double d = digital ? option::digital::delta(N, f, s, k_) : option::black::delta(N, f, s, k_);
+		double g = digital ? option::digital::gamma(N, f, s, k_) : option::black::gamma(N, f, s, k_);
+		double dv = digital ? option::digital::vega(N, f, s, k_) : option::black::vega(N, f, s, k_);
+		assert(fabs(y[0][i] - D * v) <= 1e-13);
+		assert(fabs(y[1][i] - d) <= 1e-14);
+		assert(fabs(y[2][i] - g / D) <= 1e-14);
+		assert(fabs(y[3][i] - dv * D * sqrt(t[i])) <= 1e-13);
+		assert(y[4][i] == option::bsm::theta(N, r[i], S[i], sigma[i], c[i], k[i], t[i]));
+	}
+
+	return 0;
+}
+
+int option_bsm_expiry_test()
+{
+	double r = 0.03, S = 100, sigma = 0.25, t = 0.75;
+	option::bsm::expiry<> e(N, r, S, sigma, t);
+	assert(e.discount() == exp(-r * t));
+	assert(e.forward() == S / e.discount());
+	assert(e.stdev() == sigma * sqrt(t));
+
+	double k[50], y[50];
+	for (int i = 0; i < 50; ++i) {
+		k[i] = 60 + 2 * i;
+	}
+	e.value<CALL>(50, k, y);
+	for (int i = 0; i < 50; ++i) {
+		assert(fabs(y[i] - option::bsm::value(N, r, S, sigma, CALL, k[i], t)) <= 1e-13);
+		double x = option::moneyness(N, e.forward(), e.stdev(), k[i]);
+		assert(fabs(e.moneyness(k[i]) - x) <= 1e-14);
+	}
+	e.vega<DIGITAL_PUT>(50, k, y);
+	for (int i = 0; i < 50; ++i) {
+		assert(y[i] == option::bsm::vega(N, r, S, sigma, DIGITAL_PUT, k[i], t));
+	}
+	assert(std::isnan(e.value<PUT>(0)));
+
+	return 0;
+}
+
+int option_bsm_portfolio_test()
+{
+	variate::normal N2; // second variate
+	const variate::base* v[] = { &N, &N2 };
+	int c[] = { PUT, CALL, DIGITAL_PUT, DIGITAL_CALL };
+	double S[] = { 100, 50, 200 }, r[] = { 0.01, 0.02, 0.03 };
+
+	// call add(u, v, c, k, t, sigma, q) for 1000 random positions using variates w
+	auto book = [&](unsigned seed, const variate::base* const* w, auto&& add) {
+		std::default_random_engine dre(seed);
+		std::uniform_int_distribution<int> I(0, 1000);
+		for (int i = 0; i < 1000; ++i) {
+			size_t u = I(dre) % 3;
+			const variate::base& v_ = *w[I(dre) % 2];
+			int c_ = c[I(dre) % 4];
+			double k = S[u] * (0.8 + 0.0004 * I(dre));
+			double t = 0.25 * (1 + I(dre) % 8);
+			double sigma = 0.1 + 0.05 * (I(dre) % 4);
+			double q = I(dre) - 500.;
+			add(u, v_, c_, k, t, sigma, q);
+		}
+	};
+	unsigned seed = std::default_random_engine::default_seed;
+
+	option::bsm::portfolio p;
+	option::bsm::risk R[3];
+	book(seed, v, [&](size_t u, const variate::base& v_, int c_, double k, double t, double sigma, double q) {
+		p.add(u, v_, c_, k, t, sigma, q);
+
+		R[u].value += q * option::bsm::value(v_, r[u], S[u], sigma, c_, k, t);
+		R[u].delta += q * option::bsm::delta(v_, r[u], S[u], sigma, c_, k, t);
+		R[u].gamma += q * option::bsm::gamma(v_, r[u], S[u], sigma, c_, k, t);
+		R[u].vega += q * option::bsm::vega(v_, r[u], S[u], sigma, c_, k, t);
+		R[u].theta += q * option::bsm::theta(v_, r[u], S[u], sigma, c_, k, t);
+	});
+	assert(p.size() == 1000 && p.underlyings() == 3);
+	assert(!p.sorted() && std::isnan(p.aggregate(S, r)[0].value));
+
+	p.sort();
+	auto R1 = p.aggregate(S, r, 1);
+	assert(p.groups() <= 3 * 2 * 8);
+	for (size_t u = 0; u < 3; ++u) {
+		assert(fabs(R1[u].value - R[u].value) <= 1e-9 * (1 + fabs(R[u].value)));
+		assert(fabs(R1[u].delta - R[u].delta) <= 1e-9 * (1 + fabs(R[u].delta)));
+		assert(fabs(R1[u].gamma - R[u].gamma) <= 1e-9 * (1 + fabs(R[u].gamma)));
+		assert(fabs(R1[u].vega - R[u].vega) <= 1e-9 * (1 + fabs(R[u].vega)));
+		assert(fabs(R1[u].theta - R[u].theta) <= 1e-9 * (1 + fabs(R[u].theta)));
+	}
+	// same bits for any number of threads
+	auto R4 = p.aggregate(S, r, 4);
+	for (size_t u = 0; u < 3; ++u) {
+		assert(R4[u].value == R1[u].value && R4[u].delta == R1[u].delta && R4[u].gamma == R1[u].gamma);
+		assert(R4[u].vega == R1[u].vega && R4[u].theta == R1[u].theta);
+	}
+
+	// scenario ladder against revaluing every position
+	double dS[] = { -0.1, 0, 0.05 }, dv[] = { -0.2, 0.1 };
+	auto P1 = p.ladder(S, r, 3, dS, 2, dv, 1);
+	auto P4 = p.ladder(S, r, 3, dS, 2, dv, 4);
+	assert(P1 == P4);
+	double V0 = R1[0].value + R1[1].value + R1[2].value;
+	for (size_t i = 0; i < 3; ++i) {
+		double S_[3] = { S[0] * (1 + dS[i]), S[1] * (1 + dS[i]), S[2] * (1 + dS[i]) };
+		for (size_t j = 0; j < 2; ++j) {
+			// shock volatility through a second portfolio
+			option::bsm::portfolio p_;
+			book(seed, v, [&](size_t u, const variate::base& v_, int c_, double k, double t, double sigma, double q) {
+				p_.add(u, v_, c_, k, t, sigma * (1 + dv[j]), q);
+			});
+			p_.sort();
+			auto R_ = p_.aggregate(S_, r, 1);
+			double dV = R_[0].value + R_[1].value + R_[2].value - V0;
+			assert(fabs(P1[i * 2 + j] - dV) <= 1e-8 * (1 + fabs(dV)));
+		}
+	}
+
+	// same bits for copies of the variates at other addresses
+	{
+		variate::normal M[2];
+		const variate::base* w[] = { &M[1], &M[0] }; // reverse address order
+		option::bsm::portfolio p_;
+		book(seed, w, [&](size_t u, const variate::base& v_, int c_, double k, double t, double sigma, double q) {
+			p_.add(u, v_, c_, k, t, sigma, q);
+		});
+		p_.sort();
+		auto R_ = p_.aggregate(S, r, 4);
+		for (size_t u = 0; u < 3; ++u) {
+			assert(R_[u].value == R1[u].value && R_[u].delta == R1[u].delta && R_[u].gamma == R1[u].gamma);
+			assert(R_[u].vega == R1[u].vega && R_[u].theta == R1[u].theta);
 		}
 	}
 
 	return 0;
 }
 
+int option_p2_test()
+{
+	std::default_random_engine dre;
+	std::normal_distribution<double> Z;
+
+	for (double p : { 0.5, 0.9, 0.99 }) {
+		fms::p2 q(p);
+		assert(std::isnan(q.quantile()));
+		std::vector<double> x(20000);
+		for (auto& xi : x) {
+			xi = Z(dre);
+			q.push_back(xi);
+		}
+		std::sort(x.begin(), x.end());
+		assert(q.size() == x.size());
+		assert(fabs(q.quantile() - x[static_cast<size_t>(p * x.size())]) < 0.02);
+	}
+
+	return 0;
+}
+
+int option_var_test()
+{
+	double S[] = { 100, 50 };
+	double t[] = { 1, 2, 5 }, f[] = { 0.02, 0.03, 0.035 };
+	pwflat::curve<> c(3, t, f, 0.04);
+
+	option::bsm::portfolio p;
+	p.add(0, N, CALL, 100, 0.5, 0.2, 10);
+	p.add(0, N, PUT, 90, 0.5, 0.25, -5);
+	p.add(1, N, PUT, 50, 1.5, 0.3, 20);
+	p.add(1, N, DIGITAL_CALL, 55, 1, 0.3, 100);
+
+	// normal spot and vol moves with a rate shift
+	std::vector<double> dS(2 * 5000), dv(2 * 5000), df(5000);
+	std::default_random_engine dre;
+	std::normal_distribution<double> Z;
+	for (size_t i = 0; i < df.size(); ++i) {
+		dS[2 * i] = 0.02 * Z(dre);
+		dS[2 * i + 1] = 0.03 * Z(dre);
+		dv[2 * i] = dv[2 * i + 1] = 0.05 * Z(dre);
+		df[i] = 0.001 * Z(dre);
+	}
+	auto scenario = [&](size_t i, double* dS_, double* dv_, double& df_) {
+		std::copy(&dS[2 * i], &dS[2 * i] + 2, dS_);
+		std::copy(&dv[2 * i], &dv[2 * i] + 2, dv_);
+		df_ = df[i];
+	};
+
+	// not sorted
+	auto r0 = option::bsm::full_revaluation(p, S, c, df.size(), scenario);
+	assert(r0.size() == 0 && std::isnan(r0.var()) && std::isnan(r0.es()));
+
+	p.sort();
+	auto r1 = option::bsm::full_revaluation(p, S, c, df.size(), scenario, 0.99, 256, 1);
+	auto r4 = option::bsm::full_revaluation(p, S, c, df.size(), scenario, 0.99, 1000, 4);
+	assert(r1.size() == df.size());
+	assert(r1.var() == r4.var() && r1.es() == r4.es());
+
+	// losses by direct revaluation
+	double zero[2] = { 0, 0 };
+	double V0 = p.value(S, zero, [&c](double u) { return c.spot(u); });
+	std::vector<double> L(df.size());
+	for (size_t i = 0; i < L.size(); ++i) {
+		double S_[2] = { S[0] * (1 + dS[2 * i]), S[1] * (1 + dS[2 * i + 1]) };
+		double V = 0;
+		V += 10 * option::bsm::value(N, c.spot(0.5) + df[i], S_[0], 0.2 * (1 + dv[2 * i]), CALL, 100., 0.5);
+		V += -5 * option::bsm::value(N, c.spot(0.5) + df[i], S_[0], 0.25 * (1 + dv[2 * i]), PUT, 90., 0.5);
+		V += 20 * option::bsm::value(N, c.spot(1.5) + df[i], S_[1], 0.3 * (1 + dv[2 * i + 1]), PUT, 50., 1.5);
+		V += 100 * option::bsm::value(N, c.spot(1.) + df[i], S_[1], 0.3 * (1 + dv[2 * i + 1]), DIGITAL_CALL, 55., 1.);
+		L[i] = V0 - V;
+	}
+	std::sort(L.begin(), L.end(), std::greater<double>{});
+	// 50 largest losses
+	double es = 0;
+	for (size_t i = 0; i < 50; ++i) {
+		es += L[i];
+	}
+	es /= 50;
+	assert(fabs(r1.es() - es) <= 1e-10 * fabs(es));
+	assert(L[50] <= r1.var() + 0.05 * fabs(L[50]) && r1.var() <= L[49] + 0.05 * fabs(L[49]));
+
+	return 0;
+}
+
 int option_value_test_ = option_value_test();
 int option_delta_test_ = option_delta_test();
 int option_gamma_test_ = 0;
 int option_vega_test_ = option_vega_test();
-int option_implied_test_ = 0;
+int option_implied_test_ = option_implied_test();
+int option_implied_iteration_test_ = option_implied_iteration_test();
+int option_implied_chain_test_ = option_implied_chain_test();
+int option_implied_stream_test_ = option_implied_stream_test();
 int option_variance_test_ = option_variance_test();
+int option_strike_test_ = option_strike_test();
+int option_bsm_contract_test_ = option_bsm_contract_test();
+int option_bsm_expiry_test_ = option_bsm_expiry_test();
+int option_bsm_portfolio_test_ = option_bsm_portfolio_test();
+int option_p2_test_ = option_p2_test();
+int option_var_test_ = option_var_test();
 
 #endif // _DEBUG
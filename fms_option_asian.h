@@ -0,0 +1,124 @@
+// fms_option_asian.h - Asian options on the average of n equally spaced fixings
+// The average of S_{t_i}, t_i = i t/n, i = 1, ..., n, is settled at t.
+// The geometric average of a lognormal spot is lognormal so its value is
+// a Black value with the forward and variance of the geometric average.
+// The arithmetic average is approximated by a lognormal with the same
+// first two moments (Levy, Turnbull-Wakeman).
+// Simulated arithmetic averages can use the geometric average as a
+// control variate since the two are highly correlated.
+#pragma once
+#include <cmath>
+#include <random>
+#include "fms_option.h"
+#include "fms_variate_normal.h"
+
+namespace fms::option::bsm {
+
+	// Value of a put or call on the geometric average of n fixings for the normal variate.
+	inline double asian_geometric(double r, double S, double sigma, int c, double k, double t, size_t n)
+	{
+		if (!(S > 0 && sigma > 0 && k > 0 && t > 0 && n > 0) || (c != contract::PUT && c != contract::CALL)) {
+			return NaN;
+		}
+
+		static variate::normal N;
+		// log G = log S + (r - sigma^2/2) mean(t_i) + sigma mean(B_{t_i})
+		double m = t * (n + 1) / (2. * n);
+		double v = sigma * sigma * t * (n + 1) * (2 * n + 1) / (6. * n * n);
+		double f = S * exp((r - sigma * sigma / 2) * m + v / 2);
+		double s = sqrt(v);
+
+		return exp(-r * t) * black::value(N, f, s, c == contract::PUT ? -k : k);
+	}
+
+	// First and second moment of the arithmetic average of n fixings.
+	inline std::pair<double, double> asian_moments(double r, double S, double sigma, double t, size_t n)
+	{
+		double dt = t / n;
+		// E[S_i] = S e^{r t_i}, E[S_i S_j] = S^2 e^{r t_i + r t_j + sigma^2 t_i}, i <= j
+		double M1 = 0, M2 = 0, Sj = 0; // Sj = sum_{j > i} e^{r t_j}
+		for (size_t i = n; i >= 1; --i) {
+			double ti = i * dt;
+			double ei = exp(r * ti);
+			M1 += ei;
+			M2 += ei * exp(sigma * sigma * ti) * (ei + 2 * Sj);
+			Sj += ei;
+		}
+
+		return { S * M1 / n, S * S * M2 / (1. * n * n) };
+	}
+
+	// Value of a put or call on the arithmetic average of n fixings using a
+	// lognormal with matching first two moments.
+	inline double asian_arithmetic(double r, double S, double sigma, int c, double k, double t, size_t n)
+	{
+		if (!(S > 0 && sigma > 0 && k > 0 && t > 0 && n > 0) || (c != contract::PUT && c != contract::CALL)) {
+			return NaN;
+		}
+
+		static variate::normal N;
+		auto [M1, M2] = asian_moments(r, S, sigma, t, n);
+		double s = sqrt(log(M2 / (M1 * M1)));
+
+		return exp(-r * t) * black::value(N, M1, s, c == contract::PUT ? -k : k);
+	}
+
+	// Monte Carlo value of a put or call on the arithmetic average of n fixings using p paths.
+	// If control is true the closed form geometric value is a control variate with
+	// coefficient estimated from the paths. If se is not null it is set to the standard error.
+	template<class URNG>
+	inline double asian_monte_carlo(URNG& g, size_t p, double r, double S, double sigma, int c, double k, double t, size_t n,
+		bool control = true, double* se = nullptr)
+	{
+		if (!(S > 0 && sigma > 0 && k > 0 && t > 0 && n > 0 && p > 1) || (c != contract::PUT && c != contract::CALL)) {
+			if (se) {
+				*se = NaN;
+			}
+
+			return NaN;
+		}
+
+		double D = exp(-r * t);
+		double dt = t / n;
+		double mu = (r - sigma * sigma / 2) * dt;
+		double s = sigma * sqrt(dt);
+		auto payoff = [c, k](double A) {
+			return c == contract::PUT ? std::max(k - A, 0.) : std::max(A - k, 0.);
+		};
+
+		// running means and co-moments of arithmetic X and geometric Y payoffs
+		double X = 0, Y = 0, XX = 0, XY = 0, YY = 0;
+		std::normal_distribution<double> Z;
+		for (size_t j = 1; j <= p; ++j) {
+			double x = log(S), A = 0, L = 0;
+			for (size_t i = 0; i < n; ++i) {
+				x += mu + s * Z(g);
+				A += exp(x);
+				L += x;
+			}
+			double Xj = D * payoff(A / n);
+			double Yj = D * payoff(exp(L / n));
+
+			double dX = Xj - X, dY = Yj - Y;
+			X += dX / j;
+			Y += dY / j;
+			XX += dX * (Xj - X);
+			XY += dX * (Yj - Y);
+			YY += dY * (Yj - Y);
+		}
+
+		double v = XX / (p - 1); // variance of X
+		double V = X;
+		if (control && YY > 0) {
+			double beta = XY / YY;
+			V -= beta * (Y - asian_geometric(r, S, sigma, c, k, t, n));
+			v = (XX - beta * XY) / (p - 1);
+		}
+		if (se) {
+			*se = sqrt(v / p);
+		}
+
+		return V;
+	}
+
+} // namespace fms::option::bsm
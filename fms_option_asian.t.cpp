@@ -0,0 +1,75 @@
+// fms_option_asian.t.cpp - Test Asian options
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include <random>
+#include "fms_option_asian.h"
+
+using namespace fms;
+using namespace fms::option;
+
+int option_asian_test()
+{
+	variate::normal N;
+	double r = 0.05, S = 100, sigma = 0.2, t = 1;
+
+	{
+		// one fixing is a European option
+		for (int c : { contract::PUT, contract::CALL }) {
+			for (double k : { 90., 100., 110. }) {
+				double v = bsm::value(N, r, S, sigma, c, k, t);
+				assert(fabs(bsm::asian_geometric(r, S, sigma, c, k, t, 1) - v) < 1e-12);
+				assert(fabs(bsm::asian_arithmetic(r, S, sigma, c, k, t, 1) - v) < 1e-12);
+			}
+		}
+	}
+	{
+		// moments of the average
+		auto [M1, M2] = bsm::asian_moments(0, S, sigma, t, 2);
+		assert(fabs(M1 - S) < 1e-12);
+		// E[(S_1 + S_2)^2]/4 with t_1 = t/2, t_2 = t
+		double M2_ = S * S * (exp(sigma * sigma * t / 2) * 3 + exp(sigma * sigma * t)) / 4;
+		assert(fabs(M2 - M2_) < 1e-10);
+	}
+	{
+		// geometric average is less than arithmetic average
+		double g = bsm::asian_geometric(r, S, sigma, contract::CALL, 100, t, 12);
+		double a = bsm::asian_arithmetic(r, S, sigma, contract::CALL, 100, t, 12);
+		assert(g < a);
+		assert(a < bsm::value(N, r, S, sigma, contract::CALL, 100., t));
+	}
+
+	return 0;
+}
+int option_asian_test_ = option_asian_test();
+
+int option_asian_monte_carlo_test()
+{
+	double r = 0.05, S = 100, sigma = 0.2, t = 1;
+	size_t p = 10000, n = 12;
+
+	for (int c : { contract::PUT, contract::CALL }) {
+		for (double k : { 90., 100., 110. }) {
+			std::mt19937_64 g;
+			double se = NaN, se_ = NaN;
+			double v = bsm::asian_monte_carlo(g, p, r, S, sigma, c, k, t, n, true, &se);
+			double v_ = bsm::asian_monte_carlo(g, p, r, S, sigma, c, k, t, n, false, &se_);
+			assert(se < se_ / 10);
+			assert(fabs(v - v_) < 4 * se_);
+			// moment matching is accurate for moderate volatility
+			assert(fabs(v - bsm::asian_arithmetic(r, S, sigma, c, k, t, n)) < 0.05 + 0.01 * v);
+		}
+	}
+	// invalid arguments
+	{
+		std::mt19937_64 g;
+		double se = 0;
+		assert(std::isnan(bsm::asian_monte_carlo(g, 1, r, S, sigma, contract::CALL, 100., t, n, true, &se)));
+		assert(std::isnan(se));
+	}
+
+	return 0;
+}
+int option_asian_monte_carlo_test_ = option_asian_monte_carlo_test();
+
+#endif // _DEBUG
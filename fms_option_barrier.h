@@ -0,0 +1,196 @@
+// fms_option_barrier.h - Single barrier options
+// The option knocks in or out the first time the spot crosses the barrier h
+// before expiration. A rebate is paid at expiration if an out option knocks
+// out or an in option never knocks in.
+//
+// Closed forms use the reflection principle for Brownian motion with drift.
+// If X_t = sigma B_t + nu t and b = log(h/S) < 0 then for x > b
+//	P(X_t in dx, min X <= b) = e^{alpha b} P(X_t + 2b in dx), alpha = 2 nu/sigma^2,
+// so the part of E[g(S_t) 1(S_t > h)] from paths that hit h is
+// (h/S)^alpha E[g(S'_t) 1(S'_t > h)] where S'_0 = h^2/S. Barrier values
+// are vanilla and digital values at S and h^2/S.
+//
+// The Monte Carlo pricer simulates log spot at the monitoring dates and
+// multiplies the probability of not crossing between dates given the end points,
+//	1 - exp(-2 (x_0 - b)(x_1 - b)/(sigma^2 dt)),
+// so coarse time grids converge to the continuously monitored value.
+#pragma once
+#include <cmath>
+#include <random>
+#include "fms_monte_carlo.h"
+#include "fms_option.h"
+#include "fms_variate_normal.h"
+
+namespace fms::option {
+
+	enum barrier {
+		DOWN_IN = 1,
+		DOWN_OUT,
+		UP_IN,
+		UP_OUT,
+	};
+
+	namespace bsm {
+
+		namespace detail {
+
+			// E[D g(S_t) 1(S_t > h)] for down barriers or E[D g(S_t) 1(S_t < h)] for up barriers
+			// and g = 1 if c is 0.
+			inline double barrier_part(double r, double S, double sigma, int c, double k, double t, bool down, double h)
+			{
+				static variate::normal N;
+
+				switch (c) {
+				case 0:
+					return value(N, r, S, sigma, down ? contract::DIGITAL_CALL : contract::DIGITAL_PUT, h, t);
+				case contract::CALL:
+					if (!down) {
+						// (S_t - k) 1(k < S_t < h)
+						return k >= h ? 0
+							: value(N, r, S, sigma, contract::CALL, k, t) - value(N, r, S, sigma, contract::CALL, h, t)
+							- (h - k) * value(N, r, S, sigma, contract::DIGITAL_CALL, h, t);
+					}
+					// (S_t - k) 1(S_t > max(k, h))
+					return k >= h ? value(N, r, S, sigma, contract::CALL, k, t)
+						: value(N, r, S, sigma, contract::CALL, h, t) + (h - k) * value(N, r, S, sigma, contract::DIGITAL_CALL, h, t);
+				case contract::PUT:
+					if (down) {
+						// (k - S_t) 1(h < S_t < k)
+						return k <= h ? 0
+							: value(N, r, S, sigma, contract::PUT, k, t) - value(N, r, S, sigma, contract::PUT, h, t)
+							- (k - h) * value(N, r, S, sigma, contract::DIGITAL_PUT, h, t);
+					}
+					// (k - S_t) 1(S_t < min(k, h))
+					return k <= h ? value(N, r, S, sigma, contract::PUT, k, t)
+						: value(N, r, S, sigma, contract::PUT, h, t) + (k - h) * value(N, r, S, sigma, contract::DIGITAL_PUT, h, t);
+				case contract::DIGITAL_CALL:
+					if (!down) {
+						return k >= h ? 0
+							: value(N, r, S, sigma, contract::DIGITAL_CALL, k, t) - value(N, r, S, sigma, contract::DIGITAL_CALL, h, t);
+					}
+					return value(N, r, S, sigma, contract::DIGITAL_CALL, std::max(k, h), t);
+				case contract::DIGITAL_PUT:
+					if (down) {
+						return k <= h ? 0
+							: value(N, r, S, sigma, contract::DIGITAL_PUT, k, t) - value(N, r, S, sigma, contract::DIGITAL_PUT, h, t);
+					}
+					return value(N, r, S, sigma, contract::DIGITAL_PUT, std::min(k, h), t);
+				}
+
+				return NaN;
+			}
+
+			// E[D g(S_t) 1(no hit)] using the reflection principle
+			inline double barrier_survive(double r, double S, double sigma, int c, double k, double t, bool down, double h)
+			{
+				double alpha = 2 * r / (sigma * sigma) - 1;
+				double S_ = h * h / S;
+
+				return barrier_part(r, S, sigma, c, k, t, down, h) - pow(h / S, alpha) * barrier_part(r, S_, sigma, c, k, t, down, h);
+			}
+
+		} // namespace detail
+
+		// Value of contract c with strike k > 0 and expiration t having barrier b at h with rebate R
+		// for the normal variate. Continuously monitored.
+		inline double barrier_value(double r, double S, double sigma, int c, double k, double t, barrier b, double h, double R = 0)
+		{
+			if (!(S > 0 && sigma > 0 && k > 0 && t > 0 && h > 0)) {
+				return NaN;
+			}
+
+			static variate::normal N;
+			bool down = b == DOWN_IN || b == DOWN_OUT;
+			bool out = b == DOWN_OUT || b == UP_OUT;
+			if (!down && b != UP_IN && b != UP_OUT) {
+				return NaN;
+			}
+
+			double D = exp(-r * t);
+			// already hit
+			if (down ? S <= h : S >= h) {
+				return out ? R * D : value(N, r, S, sigma, c, k, t);
+			}
+
+			double v = detail::barrier_survive(r, S, sigma, c, k, t, down, h); // knock out
+			double p = detail::barrier_survive(r, S, sigma, 0, k, t, down, h); // D P(no hit)
+
+			return out ? v + R * (D - p) : value(N, r, S, sigma, c, k, t) - v + R * p;
+		}
+
+		// Monte Carlo barrier value using n paths with m monitoring dates.
+		// If bridge is true the barrier is monitored continuously between dates
+		// using Brownian bridge crossing probabilities, otherwise only at the dates.
+		template<class URNG>
+		inline double barrier_monte_carlo(URNG& g, size_t n, size_t m, double r, double S, double sigma, int c, double k, double t,
+			barrier b, double h, double R = 0, bool bridge = true)
+		{
+			if (!(S > 0 && sigma > 0 && k > 0 && t > 0 && h > 0 && m > 0)) {
+				return NaN;
+			}
+
+			bool down = b == DOWN_IN || b == DOWN_OUT;
+			bool out = b == DOWN_OUT || b == UP_OUT;
+			double D = exp(-r * t);
+			double dt = t / m;
+			double mu = (r - sigma * sigma / 2) * dt;
+			double s = sigma * sqrt(dt);
+			double lh = log(h);
+
+			std::normal_distribution<double> Z;
+			auto path = [&]() {
+				double x = log(S);
+				// probability of not crossing so far
+				double p = down ? x > lh : x < lh;
+				for (size_t j = 0; j < m; ++j) {
+					double x_ = x + mu + s * Z(g);
+					if (down ? x_ <= lh : x_ >= lh) {
+						p = 0;
+					}
+					else if (bridge && p > 0) {
+						p *= 1 - exp(-2 * (x - lh) * (x_ - lh) / (s * s));
+					}
+					x = x_;
+				}
+
+				double ST = exp(x);
+				double v = 0;
+				switch (c) {
+				case contract::PUT:
+					v = std::max(k - ST, 0.);
+					break;
+				case contract::CALL:
+					v = std::max(ST - k, 0.);
+					break;
+				case contract::DIGITAL_PUT:
+					v = ST <= k;
+					break;
+				case contract::DIGITAL_CALL:
+					v = ST > k;
+					break;
+				}
+
+				return D * (out ? p * v + (1 - p) * R : (1 - p) * v + p * R);
+			};
+
+			return monte_carlo::average(n, path);
+		}
+
+	} // namespace bsm
+
+	namespace black {
+
+		// Forward value of put (k < 0) or call (k > 0) with barrier b at h on the forward
+		// and rebate R for the normal variate with vol s over the life of the option.
+		inline double barrier_value(double f, double s, double k, barrier b, double h, double R = 0)
+		{
+			if (k == 0) {
+				return NaN;
+			}
+
+			return bsm::barrier_value(0, f, s, k < 0 ? contract::PUT : contract::CALL, fabs(k), 1, b, h, R);
+		}
+
+	} // namespace black
+
+} // namespace fms::option
@@ -0,0 +1,81 @@
+// fms_option_barrier.t.cpp - Test barrier options
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include <random>
+#include "fms_option_barrier.h"
+
+using namespace fms;
+using namespace fms::option;
+
+int option_barrier_test()
+{
+	variate::normal N;
+	double r = 0.05, S = 100, sigma = 0.25, t = 1, R = 1.5;
+
+	{
+		// in + out = vanilla + discounted rebate
+		for (int c : { contract::PUT, contract::CALL, contract::DIGITAL_PUT, contract::DIGITAL_CALL }) {
+			for (double k : { 80., 100., 130. }) {
+				double v = bsm::value(N, r, S, sigma, c, k, t);
+				double di = bsm::barrier_value(r, S, sigma, c, k, t, DOWN_IN, 85, R);
+				double do_ = bsm::barrier_value(r, S, sigma, c, k, t, DOWN_OUT, 85, R);
+				assert(fabs(di + do_ - v - R * exp(-r * t)) < 1e-12);
+				double ui = bsm::barrier_value(r, S, sigma, c, k, t, UP_IN, 120, R);
+				double uo = bsm::barrier_value(r, S, sigma, c, k, t, UP_OUT, 120, R);
+				assert(fabs(ui + uo - v - R * exp(-r * t)) < 1e-12);
+				assert(di >= 0 && do_ >= 0 && ui >= 0 && uo >= 0);
+			}
+		}
+	}
+	{
+		// distant barriers do not matter
+		double c = bsm::value(N, r, S, sigma, contract::CALL, 100., t);
+		assert(fabs(bsm::barrier_value(r, S, sigma, contract::CALL, 100, t, DOWN_OUT, 1) - c) < 1e-12);
+		assert(fabs(bsm::barrier_value(r, S, sigma, contract::CALL, 100, t, UP_IN, 1e3)) < 1e-10);
+		// up and out call with strike above barrier is worthless
+		assert(bsm::barrier_value(r, S, sigma, contract::CALL, 130, t, UP_OUT, 120) == 0);
+		// already knocked out
+		assert(bsm::barrier_value(r, S, sigma, contract::CALL, 100, t, DOWN_OUT, 110, R) == R * exp(-r * t));
+	}
+	{
+		// forward values
+		double f = 100, s = 0.2, k = -95;
+		double v = black::value(N, f, s, k);
+		double vo = black::barrier_value(f, s, k, DOWN_OUT, 90);
+		double vi = black::barrier_value(f, s, k, DOWN_IN, 90);
+		assert(fabs(vo + vi - v) < 1e-12);
+		assert(vo == bsm::barrier_value(0, f, s, contract::PUT, 95, 1, DOWN_OUT, 90));
+	}
+
+	return 0;
+}
+int option_barrier_test_ = option_barrier_test();
+
+int option_barrier_monte_carlo_test()
+{
+	double r = 0.05, S = 100, sigma = 0.25, t = 1, R = 1.5;
+	size_t n = 20000, m = 10;
+
+	for (barrier b : { DOWN_IN, DOWN_OUT, UP_IN, UP_OUT }) {
+		double h = b == DOWN_IN || b == DOWN_OUT ? 85 : 120;
+		for (int c : { contract::DIGITAL_PUT, contract::DIGITAL_CALL }) {
+			double v = bsm::barrier_value(r, S, sigma, c, 100, t, b, h, R);
+			std::mt19937_64 g;
+			double v_ = bsm::barrier_monte_carlo(g, n, m, r, S, sigma, c, 100, t, b, h, R);
+			assert(fabs(v - v_) < 0.02);
+		}
+	}
+	{
+		// discrete monitoring misses crossings between dates
+		std::mt19937_64 g;
+		double v = bsm::barrier_value(r, S, sigma, contract::DIGITAL_CALL, 100, t, DOWN_OUT, 85, R);
+		double v_ = bsm::barrier_monte_carlo(g, n, m, r, S, sigma, contract::DIGITAL_CALL, 100, t, DOWN_OUT, 85, R, false);
+		assert(v_ - v < -0.05);
+	}
+
+	return 0;
+}
+int option_barrier_monte_carlo_test_ = option_barrier_monte_carlo_test();
+
+#endif // _DEBUG
@@ -0,0 +1,127 @@
+// fms_option_implied.h - Implied volatility of an option chain
+// Each quote is inverted independently by black::implied so quotes
+// are spread over threads with no shared state other than the variate.
+// For streaming quotes implied_stream remembers the last solution of each
+// instrument and only re-solves quotes that changed, starting from a
+// first order correction of the previous volatility.
+#pragma once
+#include <cmath>
+#include <cstddef>
+#include <unordered_map>
+#include "fms_option.h"
+#include "fms_parallel.h"
+
+namespace fms::option::black {
+
+	// Implied s[i] for option values v0[i] on forward f[i] with strike k[i].
+	// On entry s[i] is the initial guess or 0 for the default.
+	// Failed quotes have s[i] = NaN and status[i] says why.
+	// Return the number of quotes that converged.
+	inline size_t implied(const variate::base& v, size_t n, const double* f, const double* v0, const double* k,
+		double* s, implied_status* status = nullptr, unsigned threads = 0, unsigned iter = 0, double tol = 0)
+	{
+		parallel_for(n, [&](size_t i) {
+			implied_status si;
+			s[i] = implied(v, f[i], v0[i], k[i], s[i], iter, tol, &si);
+			if (status) {
+				status[i] = si;
+			}
+		}, threads);
+
+		size_t ok = 0;
+		for (size_t i = 0; i < n; ++i) {
+			ok += !std::isnan(s[i]);
+		}
+
+		return ok;
+	}
+
+	// Last implied volatility and vega of each instrument keyed by K.
+	template<class K = size_t>
+	class implied_stream {
+		struct quote {
+			double f, v0, k; // last inputs
+			double s, vega;  // last solution
+			implied_status status;
+		};
+		const variate::base* v;
+		std::unordered_map<K, quote> q;
+		unsigned iter;
+		double tol;
+		size_t solves; // number of calls to implied
+	public:
+		implied_stream(const variate::base& v, unsigned iter = 0, double tol = 0)
+			: v(&v), iter(iter), tol(tol), solves(0)
+		{ }
+
+		size_t size() const
+		{
+			return q.size();
+		}
+		// number of quotes solved since construction
+		size_t solved() const
+		{
+			return solves;
+		}
+
+		// Implied s for value v0 of instrument id on forward f with strike k.
+		// Unchanged quotes return the last solution without any valuation.
+		// Changed quotes start from s + (v0 - v0_)/vega when only the value moved
+		// and from the last s otherwise.
+		double update(const K& id, double f, double v0, double k, implied_status* status = nullptr)
+		{
+			auto [i, added] = q.try_emplace(id);
+			quote& qi = i->second;
+
+			if (added || qi.f != f || qi.v0 != v0 || qi.k != k) {
+				double s0 = 0;
+				if (!added && qi.status == IMPLIED_OK) {
+					s0 = qi.s;
+					if (qi.f == f && qi.k == k && qi.vega > 0) {
+						double ds = (v0 - qi.v0) / qi.vega;
+						// large moves fall back to the default guess
+						s0 = fabs(ds) < s0 / 2 ? s0 + ds : 0;
+					}
+				}
+
+				qi.f = f;
+				qi.v0 = v0;
+				qi.k = k;
+				qi.s = implied(*v, f, v0, k, s0, iter, tol, &qi.status);
+				qi.vega = qi.status == IMPLIED_OK ? vega(*v, f, qi.s, k) : 0;
+				++solves;
+			}
+			if (status) {
+				*status = qi.status;
+			}
+
+			return qi.s;
+		}
+		// Update n quotes and put implied volatilities in s.
+		void update(size_t n, const K* id, const double* f, const double* v0, const double* k,
+			double* s, implied_status* status = nullptr)
+		{
+			for (size_t i = 0; i < n; ++i) {
+				s[i] = update(id[i], f[i], v0[i], k[i], status ? status + i : nullptr);
+			}
+		}
+
+		// last implied volatility of id or NaN if never updated
+		double operator[](const K& id) const
+		{
+			auto i = q.find(id);
+
+			return i == q.end() ? NaN : i->second.s;
+		}
+
+		void erase(const K& id)
+		{
+			q.erase(id);
+		}
+		void clear()
+		{
+			q.clear();
+		}
+	};
+
+} // namespace fms::option::black
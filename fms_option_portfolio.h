@@ -0,0 +1,275 @@
+// fms_option_portfolio.h - Aggregate value and greeks of option positions
+// Positions are stored as a structure of arrays sorted by underlying, variate,
+// expiry, contract, and volatility. Variates are ordered by their first add()
+// so the order of groups, and of floating point sums, is the same on every run.
+// Each group of positions with the same underlying, variate, and expiry is
+// priced on one thread using bsm::expiry so runs of equal contract and
+// volatility share D, f, s, and kappa(s).
+// Group totals are summed in group order so results do not depend on the
+// number of threads. A scenario ladder revalues each group over a grid of
+// relative spot and volatility shocks the same way.
+#pragma once
+#include <algorithm>
+#include <numeric>
+#include <vector>
+#include "fms_option.h"
+#include "fms_parallel.h"
+
+namespace fms::option::bsm {
+
+	// quantity weighted value and greeks
+	struct risk {
+		double value = 0, delta = 0, gamma = 0, vega = 0, theta = 0;
+
+		risk& operator+=(const risk& r)
+		{
+			value += r.value;
+			delta += r.delta;
+			gamma += r.gamma;
+			vega += r.vega;
+			theta += r.theta;
+
+			return *this;
+		}
+	};
+
+	class portfolio {
+		std::vector<size_t> u; // underlying index
+		std::vector<const variate::base*> v;
+		std::vector<size_t> o; // index of v in V
+		std::vector<const variate::base*> V; // distinct variates in order of first add()
+		std::vector<int> c; // option::contract
+		std::vector<double> k, t, sigma, q; // strike, expiration, volatility, quantity
+		std::vector<size_t> g; // start of each group followed by size()
+		size_t n_u; // 1 + largest underlying index
+
+		template<class T>
+		static void permute(std::vector<T>& x, const std::vector<size_t>& p)
+		{
+			std::vector<T> y(x.size());
+			for (size_t i = 0; i < p.size(); ++i) {
+				y[i] = x[p[i]];
+			}
+			x.swap(y);
+		}
+
+		// group [b, e) for underlying spot S and rate r
+		template<contract C>
+		void price(size_t b, size_t e, double S, double r, risk& R) const
+		{
+			while (b < e) {
+				expiry<> x(*v[b], r, S, sigma[b], t[b]);
+				double s = sigma[b];
+				for (; b < e && sigma[b] == s; ++b) {
+					R.value += q[b] * x.value<C>(k[b]);
+					R.delta += q[b] * x.delta<C>(k[b]);
+					R.gamma += q[b] * x.gamma<C>(k[b]);
+					R.vega += q[b] * x.vega<C>(k[b]);
+					R.theta += q[b] * x.theta<C>(k[b]);
+				}
+			}
+		}
+		// Add value of group [b, e) for spot S (1 + dS[i]) and volatility sigma (1 + dv[j])
+		// to V[i nv + j] and base value to V[ns nv]. Positions of a run stay in cache
+		// while all scenarios are priced and each volatility shock shares D and kappa(s).
+		template<contract C>
+		void scenarios(size_t b, size_t e, double S, double r,
+			size_t ns, const double* dS, size_t nv, const double* dv, double* V) const
+		{
+			while (b < e) {
+				size_t e_ = b;
+				while (e_ < e && sigma[e_] == sigma[b]) {
+					++e_;
+				}
+
+				expiry<> x(*v[b], r, S, sigma[b], t[b]);
+				for (size_t i = b; i < e_; ++i) {
+					V[ns * nv] += q[i] * x.value<C>(k[i]);
+				}
+				for (size_t j = 0; j < nv; ++j) {
+					expiry<> xj(*v[b], r, S, sigma[b] * (1 + dv[j]), t[b]);
+					for (size_t i = 0; i < ns; ++i) {
+						expiry<> xij = xj.spot(1 + dS[i]);
+						double Vij = 0;
+						for (size_t l = b; l < e_; ++l) {
+							Vij += q[l] * xij.value<C>(k[l]);
+						}
+						V[i * nv + j] += Vij;
+					}
+				}
+
+				b = e_;
+			}
+		}
+		// value of group [b, e) with spot S, volatility multiplier m, and rate r
+		template<contract C>
+		double value(size_t b, size_t e, double S, double m, double r) const
+		{
+			double V = 0;
+
+			while (b < e) {
+				expiry<> x(*v[b], r, S, sigma[b] * m, t[b]);
+				double s = sigma[b];
+				for (; b < e && sigma[b] == s; ++b) {
+					V += q[b] * x.value<C>(k[b]);
+				}
+			}
+
+			return V;
+		}
+	public:
+		portfolio()
+			: n_u(0)
+		{ }
+
+		// number of positions
+		size_t size() const
+		{
+			return k.size();
+		}
+		// number of underlyings
+		size_t underlyings() const
+		{
+			return n_u;
+		}
+		// number of groups after sort()
+		size_t groups() const
+		{
+			return g.empty() ? 0 : g.size() - 1;
+		}
+		// true if sort() was called after the last add()
+		// aggregate(), value(), and ladder() return NaN if not sorted
+		bool sorted() const
+		{
+			return !g.empty();
+		}
+
+		// add quantity q of contract c with strike k > 0, expiration t, and volatility sigma
+		// on underlying u with variate v
+		portfolio& add(size_t u_, const variate::base& v_, int c_, double k_, double t_, double sigma_, double q_)
+		{
+			u.push_back(u_);
+			v.push_back(&v_);
+			o.push_back(std::find(V.begin(), V.end(), &v_) - V.begin());
+			if (o.back() == V.size()) {
+				V.push_back(&v_);
+			}
+			c.push_back(c_);
+			k.push_back(k_);
+			t.push_back(t_);
+			sigma.push_back(sigma_);
+			q.push_back(q_);
+			n_u = std::max(n_u, u_ + 1);
+			g.clear();
+
+			return *this;
+		}
+
+		// Sort positions and find groups. Call after the last add().
+		void sort()
+		{
+			std::vector<size_t> p(size());
+			std::iota(p.begin(), p.end(), 0);
+			std::stable_sort(p.begin(), p.end(), [this](size_t i, size_t j) {
+				if (u[i] != u[j]) return u[i] < u[j];
+				if (o[i] != o[j]) return o[i] < o[j];
+				if (t[i] != t[j]) return t[i] < t[j];
+				if (c[i] != c[j]) return c[i] < c[j];
+
+				return sigma[i] < sigma[j];
+			});
+			permute(u, p);
+			permute(v, p);
+			permute(o, p);
+			permute(c, p);
+			permute(k, p);
+			permute(t, p);
+			permute(sigma, p);
+			permute(q, p);
+
+			g.clear();
+			for (size_t i = 0; i < size(); ++i) {
+				if (i == 0 || u[i] != u[i - 1] || o[i] != o[i - 1] || t[i] != t[i - 1]) {
+					g.push_back(i);
+				}
+			}
+			g.push_back(size());
+		}
+
+		// Risk of each underlying given spots S[u] and rates r[u].
+		std::vector<risk> aggregate(const double* S, const double* r, unsigned threads = 0) const
+		{
+			if (!sorted()) {
+				return std::vector<risk>(n_u, risk{ NaN, NaN, NaN, NaN, NaN });
+			}
+
+			std::vector<risk> G(groups());
+			parallel_for(groups(), [&](size_t j) {
+				size_t u_ = u[g[j]];
+				for_each_contract(g[j + 1] - g[j], c.data() + g[j], [&](auto C, size_t b, size_t e) {
+					price<decltype(C)::value>(g[j] + b, g[j] + e, S[u_], r[u_], G[j]);
+				});
+			}, threads, 1);
+
+			std::vector<risk> R(n_u);
+			for (size_t j = 0; j < groups(); ++j) {
+				R[u[g[j]]] += G[j];
+			}
+
+			return R;
+		}
+
+		// Value of the book with spots S[u], volatilities multiplied by 1 + dv[u],
+		// and continuously compounded rate r(t) to expiration t.
+		// Groups are summed in order on the calling thread. NaN if not sorted.
+		template<class R>
+		double value(const double* S, const double* dv, R&& r) const
+		{
+			if (!sorted()) {
+				return NaN;
+			}
+
+			double V = 0;
+			for (size_t j = 0; j < groups(); ++j) {
+				size_t u_ = u[g[j]];
+				double r_ = r(t[g[j]]);
+				for_each_contract(g[j + 1] - g[j], c.data() + g[j], [&](auto C, size_t b, size_t e) {
+					V += value<decltype(C)::value>(g[j] + b, g[j] + e, S[u_], 1 + dv[u_], r_);
+				});
+			}
+
+			return V;
+		}
+
+		// Change in value of the book when every spot is multiplied by 1 + dS[i]
+		// and every volatility by 1 + dv[j]. Return ns x nv values in row major order.
+		std::vector<double> ladder(const double* S, const double* r,
+			size_t ns, const double* dS, size_t nv, const double* dv, unsigned threads = 0) const
+		{
+			size_t m = ns * nv;
+			if (!sorted()) {
+				return std::vector<double>(m, NaN);
+			}
+
+			std::vector<double> G(groups() * (m + 1), 0.);
+			parallel_for(groups(), [&](size_t j) {
+				size_t u_ = u[g[j]];
+				double* Gj = G.data() + j * (m + 1);
+				for_each_contract(g[j + 1] - g[j], c.data() + g[j], [&](auto C, size_t b, size_t e) {
+					scenarios<decltype(C)::value>(g[j] + b, g[j] + e, S[u_], r[u_], ns, dS, nv, dv, Gj);
+				});
+			}, threads, 1);
+
+			std::vector<double> P(m, 0.);
+			for (size_t j = 0; j < groups(); ++j) {
+				const double* Gj = G.data() + j * (m + 1);
+				for (size_t i = 0; i < m; ++i) {
+					P[i] += Gj[i] - Gj[m];
+				}
+			}
+
+			return P;
+		}
+	};
+
+} // namespace fms::option::bsm
@@ -0,0 +1,174 @@
+// fms_option_rates.h - Caps, floors, and swaptions on a pwflat forward curve
+// A strip of periods [t[i], t[i+1]], 0 <= i < n, has accrual delta_i = t[i+1] - t[i],
+// discount D_i = D(t[i]), and simple forward F_i = (D_i/D_{i+1} - 1)/delta_i.
+// All discounts are computed in one sorted sweep over the curve when the strip is
+// built so pricing caplets and swaptions on the strip does no curve lookups.
+// A caplet (CALL) or floorlet (PUT) on period i pays delta_i (F_i - k)^+ or
+// delta_i (k - F_i)^+ at t[i+1] and is fixed at t[i].
+// A payer (CALL) or receiver (PUT) swaption expiring at t[b] exercises into
+// a swap over periods [b, e) having annuity A = sum delta_i D_{i+1} and
+// swap rate S = (D_b - D_e)/A.
+// The Black model uses lognormal vol and needs k > 0. The Bachelier model uses
+// normal vol and any strike.
+#pragma once
+#include <cmath>
+#include <vector>
+#include "fms_option.h"
+#include "fms_pwflat.h"
+#include "fms_variate_normal.h"
+
+namespace fms::option::rates {
+
+	enum model {
+		BLACK,
+		BACHELIER,
+	};
+
+	// Forward value of a put or call on normal forward with
+	// standard deviation s at expiration.
+	inline double bachelier(double f, double s, int c, double k)
+	{
+		if (c == contract::PUT) {
+			// p = c - (f - k)
+			return bachelier(f, s, contract::CALL, k) - (f - k);
+		}
+		if (c != contract::CALL) {
+			return NaN;
+		}
+		if (s == 0) {
+			return std::max(f - k, 0.);
+		}
+
+		constexpr double sqrt2pi = 2.50662827463100050242;
+		double d = (f - k) / s;
+
+		return (f - k) * (1 + erf(d / sqrt(2.))) / 2 + s * exp(-d * d / 2) / sqrt2pi;
+	}
+
+	// Forward value of put or call with vol sigma to expiration t.
+	inline double value(model m, double f, double sigma, int c, double k, double t)
+	{
+		static variate::normal N;
+		double s = sigma * sqrt(t);
+
+		if (m == BACHELIER) {
+			return bachelier(f, s, c, k);
+		}
+		if (!(k > 0) || (c != contract::PUT && c != contract::CALL)) {
+			return NaN;
+		}
+		if (s == 0) {
+			// fixed
+			return c == contract::PUT ? std::max(k - f, 0.) : std::max(f - k, 0.);
+		}
+
+		return black::value(N, f, s, c == contract::PUT ? -k : k);
+	}
+
+	class strip {
+		std::vector<double> t, D, F; // dates, discounts, period forwards
+	public:
+		// true if 0 <= t[0] < ... < t[n]
+		static bool increasing(size_t n, const double* t)
+		{
+			if (!(t[0] >= 0)) {
+				return false;
+			}
+			for (size_t i = 0; i < n; ++i) {
+				if (!(t[i] < t[i + 1])) {
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		// Periods between n + 1 strictly increasing dates t[0] >= 0.
+		// Discounts and forwards are NaN otherwise since unsorted dates
+		// give wrong discounts and repeated dates have zero accrual.
+		strip(const pwflat::curve<>& f, size_t n, const double* t)
+			: t(t, t + n + 1), D(n + 1, NaN), F(n, NaN)
+		{
+			if (!increasing(n, t)) {
+				return;
+			}
+
+			f.discount(n + 1, t, D.data());
+			for (size_t i = 0; i < n; ++i) {
+				F[i] = (D[i] / D[i + 1] - 1) / accrual(i);
+			}
+		}
+
+		// number of periods
+		size_t size() const
+		{
+			return F.size();
+		}
+		double date(size_t i) const
+		{
+			return t[i];
+		}
+		double discount(size_t i) const
+		{
+			return D[i];
+		}
+		double accrual(size_t i) const
+		{
+			return t[i + 1] - t[i];
+		}
+		double forward(size_t i) const
+		{
+			return F[i];
+		}
+
+		// sum_{b <= i < e} delta_i D_{i+1}
+		double annuity(size_t b, size_t e) const
+		{
+			double A = 0;
+			for (size_t i = b; i < e; ++i) {
+				A += accrual(i) * D[i + 1];
+			}
+
+			return A;
+		}
+		double swap_rate(size_t b, size_t e) const
+		{
+			return (D[b] - D[e]) / annuity(b, e);
+		}
+
+		// Value of each caplet (CALL) or floorlet (PUT) with vol sigma[i] in y[i].
+		void caplets(const double* sigma, int c, double k, double* y, model m = BLACK) const
+		{
+			for (size_t i = 0; i < size(); ++i) {
+				y[i] = accrual(i) * D[i + 1] * value(m, F[i], sigma[i], c, k, t[i]);
+			}
+		}
+		// Sum of caplet or floorlet values over periods [b, e).
+		double cap(size_t b, size_t e, const double* sigma, int c, double k, model m = BLACK) const
+		{
+			if (!(b <= e && e <= size())) {
+				return NaN;
+			}
+
+			double v = 0;
+			for (size_t i = b; i < e; ++i) {
+				v += accrual(i) * D[i + 1] * value(m, F[i], sigma[i], c, k, t[i]);
+			}
+
+			return v;
+		}
+
+		// Payer (CALL) or receiver (PUT) swaption expiring at t[b] on the swap over periods [b, e).
+		double swaption(size_t b, size_t e, double sigma, int c, double k, model m = BLACK) const
+		{
+			if (!(b < e && e <= size())) {
+				return NaN;
+			}
+
+			double A = annuity(b, e);
+
+			return A * value(m, (D[b] - D[e]) / A, sigma, c, k, t[b]);
+		}
+	};
+
+} // namespace fms::option::rates
@@ -0,0 +1,112 @@
+// fms_option_rates.t.cpp - Test caps, floors, and swaptions
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include <vector>
+#include "fms_option_rates.h"
+
+using namespace fms;
+using namespace fms::option;
+
+int option_rates_test()
+{
+	variate::normal N;
+	double u[] = { 1, 2, 5, 10 };
+	double f[] = { 0.02, 0.025, 0.03, 0.035 };
+	pwflat::curve<> c(4, u, f, 0.035);
+
+	// quarterly periods for 5 years
+	size_t n = 20;
+	std::vector<double> t(n + 1), sigma(n, 0.2), y(n), z(n);
+	for (size_t i = 0; i <= n; ++i) {
+		t[i] = 0.25 * i;
+	}
+	rates::strip s(c, n, t.data());
+	assert(s.size() == n);
+
+	{
+		// discounts and forwards from the curve
+		for (size_t i = 0; i < n; ++i) {
+			double D0 = c.discount(t[i]), D1 = c.discount(t[i + 1]);
+			assert(fabs(s.discount(i) - D0) < 1e-15);
+			assert(fabs(s.forward(i) - (D0 / D1 - 1) / 0.25) < 1e-12);
+		}
+		assert(s.discount(0) == 1);
+	}
+	{
+		// caplets are Black values
+		double k = 0.03;
+		s.caplets(sigma.data(), contract::CALL, k, y.data());
+		// first caplet is already fixed
+		assert(fabs(y[0] - 0.25 * s.discount(1) * std::max(s.forward(0) - k, 0.)) < 1e-15);
+		for (size_t i = 1; i < n; ++i) {
+			double v = 0.25 * s.discount(i + 1) * black::value(N, s.forward(i), sigma[i] * sqrt(t[i]), k);
+			assert(fabs(y[i] - v) < 1e-15);
+		}
+	}
+	{
+		// cap - floor = swap
+		for (auto m : { rates::BLACK, rates::BACHELIER }) {
+			std::vector<double> vol(n, m == rates::BLACK ? 0.2 : 0.006);
+			double k = 0.028;
+			double cap = s.cap(0, n, vol.data(), contract::CALL, k, m);
+			double floor = s.cap(0, n, vol.data(), contract::PUT, k, m);
+			double swap = s.discount(0) - s.discount(n) - k * s.annuity(0, n);
+			assert(fabs(cap - floor - swap) < 1e-14);
+
+			// payer - receiver = forward starting swap
+			double S = s.swap_rate(4, n);
+			double A = s.annuity(4, n);
+			double p = s.swaption(4, n, vol[0], contract::CALL, k, m);
+			double r = s.swaption(4, n, vol[0], contract::PUT, k, m);
+			assert(fabs(p - r - A * (S - k)) < 1e-14);
+			// at the money payer equals receiver
+			assert(fabs(s.swaption(4, n, vol[0], contract::CALL, S, m) - s.swaption(4, n, vol[0], contract::PUT, S, m)) < 1e-14);
+		}
+	}
+	{
+		// Bachelier at the money is s/sqrt(2 pi)
+		assert(fabs(rates::bachelier(0.03, 0.01, contract::CALL, 0.03) - 0.01 / sqrt(2 * 3.14159265358979323846)) < 1e-15);
+		// negative forwards are fine
+		assert(rates::bachelier(-0.005, 0.01, contract::CALL, 0.001) > 0);
+		// zero and negative strikes
+		for (double k : { 0., -0.01 }) {
+			double f = -0.002, sd = 0.01;
+			double c = rates::bachelier(f, sd, contract::CALL, k);
+			double p = rates::bachelier(f, sd, contract::PUT, k);
+			assert(c > 0 && p > 0);
+			assert(fabs(c - p - (f - k)) < 1e-15);
+		}
+		std::vector<double> vol(n, 0.006);
+		double cap = s.cap(0, n, vol.data(), contract::CALL, -0.01, rates::BACHELIER);
+		double floor = s.cap(0, n, vol.data(), contract::PUT, -0.01, rates::BACHELIER);
+		assert(fabs(cap - floor - (s.discount(0) - s.discount(n) + 0.01 * s.annuity(0, n))) < 1e-14);
+		// Black needs a positive strike
+		assert(std::isnan(s.cap(0, n, vol.data(), contract::CALL, 0, rates::BLACK)));
+		assert(std::isnan(rates::value(rates::BLACK, 0.03, 0.2, contract::DIGITAL_CALL, 0.03, 1)));
+	}
+	{
+		// periods must lie in the strip
+		std::vector<double> vol(n, 0.2);
+		assert(s.cap(2, 2, vol.data(), contract::CALL, 0.03) == 0);
+		assert(std::isnan(s.cap(3, 2, vol.data(), contract::CALL, 0.03)));
+		assert(std::isnan(s.cap(0, n + 1, vol.data(), contract::CALL, 0.03)));
+		assert(std::isnan(s.swaption(2, 2, 0.2, contract::CALL, 0.03)));
+		assert(std::isnan(s.swaption(0, n + 1, 0.2, contract::CALL, 0.03)));
+	}
+	{
+		// dates must be strictly increasing
+		double u[] = { 0, 0.5, 0.5, 1 };
+		rates::strip s_(c, 3, u);
+		assert(!rates::strip::increasing(3, u));
+		assert(std::isnan(s_.discount(0)) && std::isnan(s_.forward(2)));
+		double v[] = { 0, 1, 0.5 };
+		assert(!rates::strip::increasing(2, v));
+		assert(rates::strip::increasing(2, t.data()));
+	}
+
+	return 0;
+}
+int option_rates_test_ = option_rates_test();
+
+#endif // _DEBUG
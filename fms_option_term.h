@@ -0,0 +1,84 @@
+// fms_option_term.h - Option values using rate and volatility term structures
+// Discounting uses D(t) = exp(-int_0^t r(u) du) from a pwflat::curve of forward rates
+// and the Black vol is s(t) = sqrt(int_0^t var(u) du) from a pwflat::curve of
+// instantaneous variance. This is the same as using the flat rate and volatility
+//	r = int_0^t r(u) du/t, sigma = sqrt(int_0^t var(u) du/t)
+// so each expiration is priced with bsm::expiry. Greeks are with respect to
+// spot and the equivalent flat volatility.
+#pragma once
+#include <cmath>
+#include "fms_option.h"
+#include "fms_pwflat.h"
+
+namespace fms::option::bsm {
+
+	// Parameters for expiration t > 0 given rate and variance curves.
+	inline expiry<> term_expiry(const variate::base& v, const pwflat::curve<>& r, const pwflat::curve<>& var, double S, double t)
+	{
+		double R = r.integral(t);
+		double V = var.integral(t);
+
+		return expiry<>(v, t > 0 ? R / t : NaN, S, t > 0 && V >= 0 ? sqrt(V / t) : NaN, t);
+	}
+
+	template<contract C>
+	inline double value(const variate::base& v, const pwflat::curve<>& r, const pwflat::curve<>& var, double S, double k, double t)
+	{
+		return term_expiry(v, r, var, S, t).template value<C>(k);
+	}
+	template<contract C>
+	inline double delta(const variate::base& v, const pwflat::curve<>& r, const pwflat::curve<>& var, double S, double k, double t)
+	{
+		return term_expiry(v, r, var, S, t).template delta<C>(k);
+	}
+
+	// Apply g(x, C, i, j) to positions [i, j) having the same expiration and contract
+	// where x is the expiry and C is the contract as an integral constant.
+	// Expirations t[i] are grouped when equal to the previous one so sort by t to share curve lookups.
+	template<class G>
+	inline void for_each_expiry(const variate::base& v, const pwflat::curve<>& r, const pwflat::curve<>& var, double S,
+		size_t n, const int* c, const double* t, G&& g)
+	{
+		for (size_t i = 0, j; i < n; i = j) {
+			for (j = i + 1; j < n && t[j] == t[i]; ++j)
+				;
+
+			expiry<> x = term_expiry(v, r, var, S, t[i]);
+			for_each_contract(j - i, c + i, [&](auto C, size_t b, size_t e) {
+				g(x, C, i + b, i + e);
+			});
+		}
+	}
+
+	// Values y[i] of n positions with contracts c[i], strikes k[i], and expirations t[i] on spot S.
+	inline void value(const variate::base& v, const pwflat::curve<>& r, const pwflat::curve<>& var, double S,
+		size_t n, const int* c, const double* k, const double* t, double* y)
+	{
+		for_each_expiry(v, r, var, S, n, c, t, [&](const expiry<>& x, auto C, size_t i, size_t j) {
+			x.template value<decltype(C)::value>(j - i, k + i, y + i);
+		});
+	}
+	inline void delta(const variate::base& v, const pwflat::curve<>& r, const pwflat::curve<>& var, double S,
+		size_t n, const int* c, const double* k, const double* t, double* y)
+	{
+		for_each_expiry(v, r, var, S, n, c, t, [&](const expiry<>& x, auto C, size_t i, size_t j) {
+			x.template delta<decltype(C)::value>(j - i, k + i, y + i);
+		});
+	}
+	inline void gamma(const variate::base& v, const pwflat::curve<>& r, const pwflat::curve<>& var, double S,
+		size_t n, const int* c, const double* k, const double* t, double* y)
+	{
+		for_each_expiry(v, r, var, S, n, c, t, [&](const expiry<>& x, auto C, size_t i, size_t j) {
+			x.template gamma<decltype(C)::value>(j - i, k + i, y + i);
+		});
+	}
+	// sensitivity to the equivalent flat volatility
+	inline void vega(const variate::base& v, const pwflat::curve<>& r, const pwflat::curve<>& var, double S,
+		size_t n, const int* c, const double* k, const double* t, double* y)
+	{
+		for_each_expiry(v, r, var, S, n, c, t, [&](const expiry<>& x, auto C, size_t i, size_t j) {
+			x.template vega<decltype(C)::value>(j - i, k + i, y + i);
+		});
+	}
+
+} // namespace fms::option::bsm
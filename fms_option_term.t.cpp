@@ -0,0 +1,65 @@
+// fms_option_term.t.cpp - Test option values with term structures
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include "fms_option_term.h"
+#include "fms_variate_normal.h"
+
+using namespace fms;
+using namespace fms::option;
+
+int option_term_test()
+{
+	variate::normal N;
+	double S = 100;
+
+	{
+		// flat curves are bsm
+		pwflat::curve<> r(0.05), var(0.2 * 0.2);
+		for (double t : { 0.25, 1., 3. }) {
+			for (double k : { 80., 100., 120. }) {
+				double v = bsm::value<contract::PUT>(N, r, var, S, k, t);
+				assert(fabs(v - bsm::value(N, 0.05, S, 0.2, contract::PUT, k, t)) < 1e-12);
+				double d = bsm::delta<contract::CALL>(N, r, var, S, k, t);
+				assert(fabs(d - bsm::delta(N, 0.05, S, 0.2, contract::CALL, k, t)) < 1e-12);
+			}
+		}
+	}
+	{
+		// piecewise flat curves
+		double u[] = { 0.5, 1, 2 };
+		double f[] = { 0.01, 0.02, 0.04 };
+		double s2[] = { 0.09, 0.04, 0.0225 };
+		pwflat::curve<> r(3, u, f, 0.04), var(3, u, s2, 0.0225);
+		for (double t : { 0.25, 0.75, 1.5, 3. }) {
+			double D = r.discount(t);
+			double s = sqrt(var.integral(t));
+			double v = bsm::value<contract::CALL>(N, r, var, S, 100, t);
+			assert(fabs(v - D * black::value(N, S / D, s, 100.)) < 1e-12);
+		}
+
+		// book across expirations
+		int c[] = { contract::PUT, contract::CALL, contract::CALL, contract::DIGITAL_PUT, contract::PUT, 0 };
+		double k[] = { 90, 100, 110, 100, 95, 100 };
+		double t[] = { 0.25, 0.25, 0.25, 1, 2, 2 };
+		double y[6], dy[6], gy[6], vy[6];
+		bsm::value(N, r, var, S, 6, c, k, t, y);
+		bsm::delta(N, r, var, S, 6, c, k, t, dy);
+		bsm::gamma(N, r, var, S, 6, c, k, t, gy);
+		bsm::vega(N, r, var, S, 6, c, k, t, vy);
+		for (size_t i = 0; i < 5; ++i) {
+			double R = r.integral(t[i]) / t[i];
+			double sigma = sqrt(var.integral(t[i]) / t[i]);
+			assert(fabs(y[i] - bsm::value(N, R, S, sigma, c[i], k[i], t[i])) < 1e-12);
+			assert(fabs(dy[i] - bsm::delta(N, R, S, sigma, c[i], k[i], t[i])) < 1e-12);
+			assert(fabs(gy[i] - bsm::gamma(N, R, S, sigma, c[i], k[i], t[i])) < 1e-12);
+			assert(fabs(vy[i] - bsm::vega(N, R, S, sigma, c[i], k[i], t[i])) < 1e-12);
+		}
+		assert(std::isnan(y[5]));
+	}
+
+	return 0;
+}
+int option_term_test_ = option_term_test();
+
+#endif // _DEBUG
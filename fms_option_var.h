@@ -0,0 +1,132 @@
+// fms_option_var.h - Value at risk of an option portfolio by full revaluation
+// Each scenario gives relative spot and volatility shocks for every underlying
+// and a parallel shift of the discount curve. Scenarios are generated and
+// revalued in chunks so memory does not grow with the number of positions
+// times scenarios. Losses feed a P^2 estimate of the quantile and a heap of
+// the largest (1 - alpha) m losses for expected shortfall, so memory for
+// expected shortfall grows with (1 - alpha) m, e.g. 80 KB for alpha = 0.99
+// and a million scenarios.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+#include "fms_option_portfolio.h"
+#include "fms_p2.h"
+#include "fms_pwflat.h"
+
+namespace fms::option::bsm {
+
+	// streaming value at risk and expected shortfall of losses
+	class value_at_risk {
+		double alpha;
+		p2 q;
+		size_t cap; // largest number of tail losses kept
+		std::vector<double> tail; // min heap of largest losses
+		size_t n;
+
+		// ceil((1 - alpha) n) without roundoff in 1 - alpha
+		static size_t tail_size(double alpha, size_t n)
+		{
+			return n - static_cast<size_t>(alpha * n);
+		}
+	public:
+		// alpha quantile of at most m losses
+		value_at_risk(double alpha, size_t m)
+			: alpha(alpha), q(alpha), cap(tail_size(alpha, m)), n(0)
+		{
+			tail.reserve(cap);
+		}
+
+		size_t size() const
+		{
+			return n;
+		}
+
+		value_at_risk& push_back(double loss)
+		{
+			q.push_back(loss);
+			++n;
+
+			if (tail.size() < cap) {
+				tail.push_back(loss);
+				std::push_heap(tail.begin(), tail.end(), std::greater<double>{});
+			}
+			else if (cap && loss > tail.front()) {
+				std::pop_heap(tail.begin(), tail.end(), std::greater<double>{});
+				tail.back() = loss;
+				std::push_heap(tail.begin(), tail.end(), std::greater<double>{});
+			}
+
+			return *this;
+		}
+
+		// P^2 estimate of the alpha quantile of losses
+		double var() const
+		{
+			return q.quantile();
+		}
+		// mean of the ceil((1 - alpha) n) largest losses
+		double es() const
+		{
+			size_t m = std::min(tail.size(), tail_size(alpha, n));
+			if (m == 0) {
+				return NaN;
+			}
+
+			std::vector<double> t(tail);
+			std::sort(t.begin(), t.end(), std::greater<double>{});
+			double s = 0;
+			for (size_t i = 0; i < m; ++i) {
+				s += t[i];
+			}
+
+			return s / m;
+		}
+	};
+
+	// Loss V0 - V of portfolio p for m scenarios with base spots S and curve f.
+	// scenario(i, dS, dv, df) sets relative spot and volatility shocks dS[u] and dv[u]
+	// for each underlying and a parallel forward shift df for scenario i.
+	// Scenarios are drawn in order on the calling thread and revalued in parallel
+	// chunks, so results do not depend on the number of threads.
+	// The portfolio must be sorted, otherwise no scenarios are revalued.
+	template<class Scenario>
+	inline value_at_risk full_revaluation(const portfolio& p, const double* S, const pwflat::curve<>& f,
+		size_t m, Scenario&& scenario, double alpha = 0.99, size_t chunk = 1024, unsigned threads = 0)
+	{
+		value_at_risk r(alpha, m);
+		if (!p.sorted()) {
+			return r;
+		}
+
+		size_t nu = p.underlyings();
+		std::vector<double> dS(chunk * nu), dv(chunk * nu), df(chunk), L(chunk), S_(chunk * nu);
+		std::vector<double> zero(nu, 0.);
+		double V0 = p.value(S, zero.data(), [&f](double t) { return f.spot(t); });
+
+		for (size_t i = 0; i < m; i += chunk) {
+			size_t c = std::min(chunk, m - i);
+			for (size_t j = 0; j < c; ++j) {
+				scenario(i + j, dS.data() + j * nu, dv.data() + j * nu, df[j]);
+			}
+
+			parallel_for(c, [&](size_t j) {
+				double* Sj = S_.data() + j * nu;
+				for (size_t u = 0; u < nu; ++u) {
+					Sj[u] = S[u] * (1 + dS[j * nu + u]);
+				}
+				// spot rate of the shifted curve
+				double dfj = df[j];
+				L[j] = V0 - p.value(Sj, dv.data() + j * nu, [&f, dfj](double t) { return f.spot(t) + dfj; });
+			}, threads, 1);
+
+			for (size_t j = 0; j < c; ++j) {
+				r.push_back(L[j]);
+			}
+		}
+
+		return r;
+	}
+
+} // namespace fms::option::bsm
@@ -0,0 +1,113 @@
+// fms_p2.h - Streaming quantile estimate using the P^2 algorithm
+// Jain and Chlamtac (1985) keep five markers at the minimum, p/2, p, (1 + p)/2
+// quantiles and the maximum. Each observation moves marker positions and
+// adjusts heights with a piecewise parabolic fit, so memory is constant
+// and no observations are stored.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+namespace fms {
+
+	class p2 {
+		double p;
+		double q[5];  // marker heights
+		double n[5];  // marker positions
+		double np[5]; // desired marker positions
+		double dn[5]; // increments of desired positions
+		size_t count;
+
+		double parabolic(int i, double d) const
+		{
+			return q[i] + d / (n[i + 1] - n[i - 1])
+				* ((n[i] - n[i - 1] + d) * (q[i + 1] - q[i]) / (n[i + 1] - n[i])
+				 + (n[i + 1] - n[i] - d) * (q[i] - q[i - 1]) / (n[i] - n[i - 1]));
+		}
+		double linear(int i, int d) const
+		{
+			return q[i] + d * (q[i + d] - q[i]) / (n[i + d] - n[i]);
+		}
+	public:
+		// estimate the p quantile, 0 < p < 1
+		p2(double p)
+			: p(p), q{}, n{ 0, 1, 2, 3, 4 }, np{ 0, 2 * p, 4 * p, 2 + 2 * p, 4 }, dn{ 0, p / 2, p, (1 + p) / 2, 1 }, count(0)
+		{ }
+
+		// number of observations
+		size_t size() const
+		{
+			return count;
+		}
+
+		p2& push_back(double x)
+		{
+			if (count < 5) {
+				q[count++] = x;
+				if (count == 5) {
+					std::sort(q, q + 5);
+				}
+
+				return *this;
+			}
+			++count;
+
+			// cell containing x
+			int k;
+			if (x < q[0]) {
+				q[0] = x;
+				k = 0;
+			}
+			else if (x >= q[4]) {
+				q[4] = x;
+				k = 3;
+			}
+			else {
+				k = 0;
+				while (x >= q[k + 1]) {
+					++k;
+				}
+			}
+
+			for (int i = k + 1; i < 5; ++i) {
+				n[i] += 1;
+			}
+			for (int i = 0; i < 5; ++i) {
+				np[i] += dn[i];
+			}
+
+			// adjust middle markers that are off by more than one position
+			for (int i = 1; i <= 3; ++i) {
+				double d = np[i] - n[i];
+				if ((d >= 1 && n[i + 1] - n[i] > 1) || (d <= -1 && n[i - 1] - n[i] < -1)) {
+					int d_ = d > 0 ? 1 : -1;
+					double q_ = parabolic(i, d_);
+					q[i] = q[i - 1] < q_ && q_ < q[i + 1] ? q_ : linear(i, d_);
+					n[i] += d_;
+				}
+			}
+
+			return *this;
+		}
+
+		// current estimate of the p quantile
+		double quantile() const
+		{
+			if (count == 0) {
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+			if (count < 5) {
+				// exact quantile of the few observations so far
+				double x[5];
+				std::copy(q, q + count, x);
+				std::sort(x, x + count);
+
+				return x[std::min(count - 1, static_cast<size_t>(p * count))];
+			}
+
+			return q[2];
+		}
+	};
+
+} // namespace fms
@@ -0,0 +1,189 @@
+// fms_parallel.h - Run independent loop iterations on several threads
+// Work is handed out in blocks from a shared counter so threads that draw
+// cheap iterations take more blocks and the load stays balanced.
+// Threads are started once in a pool and reused by every call.
+//
+//	parallel_for(n, [&](size_t i) { y[i] = f(x[i]); });
+//
+// The body must only write to state owned by iteration i.
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace fms {
+
+	// number of threads to use by default
+	inline unsigned hardware_threads()
+	{
+		unsigned n = std::thread::hardware_concurrency();
+
+		return n ? n : 1;
+	}
+
+	// Persistent worker threads that join the calling thread to run a job.
+	// One job runs at a time. Calls from a worker or while the pool is busy
+	// return false and the caller does the work itself, so nested loops run serially.
+	class thread_pool {
+		std::vector<std::thread> t;
+		std::mutex mx;
+		std::condition_variable start, done;
+		void (*call)(void*) = nullptr; // current job
+		void* job = nullptr;
+		size_t round = 0;     // number of jobs submitted
+		unsigned wanted = 0;  // workers still to join the current job
+		unsigned running = 0; // workers in the current job
+		bool stop = false;
+		std::atomic<bool> busy = false;
+		static inline thread_local bool active = false; // thread is running a job
+
+		void loop()
+		{
+			active = true;
+			size_t seen = 0;
+			std::unique_lock<std::mutex> lock(mx);
+			for (;;) {
+				start.wait(lock, [&] { return stop || (round != seen && wanted > 0); });
+				if (stop) {
+					return;
+				}
+				seen = round;
+				--wanted;
+				++running;
+				auto call_ = call;
+				auto job_ = job;
+				lock.unlock();
+				call_(job_);
+				lock.lock();
+				if (--running == 0) {
+					done.notify_all();
+				}
+			}
+		}
+	public:
+		thread_pool(unsigned n)
+		{
+			t.reserve(n);
+			for (unsigned i = 0; i < n; ++i) {
+				t.emplace_back([this] { loop(); });
+			}
+		}
+		thread_pool(const thread_pool&) = delete;
+		thread_pool& operator=(const thread_pool&) = delete;
+		~thread_pool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mx);
+				stop = true;
+			}
+			start.notify_all();
+			for (auto& ti : t) {
+				ti.join();
+			}
+		}
+
+		// number of worker threads
+		unsigned size() const
+		{
+			return static_cast<unsigned>(t.size());
+		}
+
+		// Call f() on the calling thread and on up to m workers then wait for all to return.
+		// Workers that have not started when the calling thread returns are not used.
+		// f must not throw.
+		template<class F>
+		bool run(F& f, unsigned m)
+		{
+			if (active || t.empty() || busy.exchange(true)) {
+				return false;
+			}
+			active = true;
+			{
+				std::lock_guard<std::mutex> lock(mx);
+				call = [](void* p) { (*static_cast<F*>(p))(); };
+				job = &f;
+				++round;
+				wanted = std::min(m, size());
+			}
+			start.notify_all();
+			f();
+			{
+				std::unique_lock<std::mutex> lock(mx);
+				wanted = 0;
+				done.wait(lock, [&] { return running == 0; });
+			}
+			active = false;
+			busy = false;
+
+			return true;
+		}
+	};
+
+	// Pool shared by parallel_for with one worker less than the number of hardware threads.
+	// It is never destroyed since joining threads from static destructors of a dll
+	// deadlocks on the loader lock. Idle workers wait on a condition variable.
+	inline thread_pool& default_pool()
+	{
+		static thread_pool* pool = new thread_pool(hardware_threads() - 1);
+
+		return *pool;
+	}
+
+	// Call f(i) for i in [0, n) using at most threads threads and blocks of size block.
+	// Threads come from default_pool so at most hardware_threads() are used.
+	// The first exception thrown by f is rethrown after all threads finish.
+	template<class F>
+	inline void parallel_for(size_t n, F&& f, unsigned threads = 0, size_t block = 64)
+	{
+		if (threads == 0) {
+			threads = hardware_threads();
+		}
+		block = std::max<size_t>(block, 1);
+		size_t blocks = (n + block - 1) / block;
+		threads = static_cast<unsigned>(std::min<size_t>(threads, blocks));
+
+		if (threads <= 1) {
+			for (size_t i = 0; i < n; ++i) {
+				f(i);
+			}
+
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		std::exception_ptr ex;
+		std::mutex mx;
+		auto run = [&]() {
+			try {
+				for (size_t b = next++; b < blocks; b = next++) {
+					size_t e = std::min(n, (b + 1) * block);
+					for (size_t i = b * block; i < e; ++i) {
+						f(i);
+					}
+				}
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(mx);
+				if (!ex) {
+					ex = std::current_exception();
+				}
+				next = blocks; // stop handing out work
+			}
+		};
+
+		// calling thread does its share
+		if (!default_pool().run(run, threads - 1)) {
+			run();
+		}
+
+		if (ex) {
+			std::rethrow_exception(ex);
+		}
+	}
+
+} // namespace fms
@@ -0,0 +1,62 @@
+// fms_parallel.t.cpp - Test parallel loops and the thread pool
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+#include "fms_parallel.h"
+
+using namespace fms;
+
+int parallel_for_test()
+{
+	{
+		// pool is reused across calls
+		std::vector<size_t> x(1000);
+		for (unsigned threads : { 1u, 2u, 4u, 0u }) {
+			for (int r = 0; r < 100; ++r) {
+				parallel_for(x.size(), [&](size_t i) { x[i] = i + r; }, threads, 16);
+				for (size_t i = 0; i < x.size(); ++i) {
+					assert(x[i] == i + r);
+				}
+			}
+		}
+	}
+	{
+		// nested loops run serially on the calling thread
+		std::vector<size_t> x(64 * 64);
+		parallel_for(64, [&](size_t i) {
+			parallel_for(64, [&](size_t j) { x[64 * i + j] = i * j; }, 0, 1);
+		}, 0, 1);
+		for (size_t i = 0; i < 64; ++i) {
+			for (size_t j = 0; j < 64; ++j) {
+				assert(x[64 * i + j] == i * j);
+			}
+		}
+	}
+	{
+		// first exception is rethrown and the pool is still usable
+		bool thrown = false;
+		try {
+			parallel_for(1000, [](size_t i) {
+				if (i == 500) {
+					throw std::runtime_error("parallel_for_test");
+				}
+			}, 4, 1);
+		}
+		catch (const std::runtime_error&) {
+			thrown = true;
+		}
+		assert(thrown);
+		std::vector<int> x(100, 0);
+		parallel_for(x.size(), [&](size_t i) { x[i] = 1; }, 4, 1);
+		for (int xi : x) {
+			assert(xi == 1);
+		}
+	}
+
+	return 0;
+}
+int parallel_for_test_ = parallel_for_test();
+
+#endif // _DEBUG
@@ -0,0 +1,327 @@
+// fms_pde.h - Finite difference option pricing
+// Solve the Black-Scholes/Merton equation in x = log S on a uniform grid
+//	V_tau = sigma^2/2 V_xx + (r - sigma^2/2) V_x - r V
+// backwards from expiration using Crank-Nicolson time steps. The first steps
+// are replaced by pairs of fully implicit half steps (Rannacher) to damp
+// oscillations from the kink of the payoff. Rates r(t) are the forwards of
+// a pwflat::curve averaged over each time step.
+// American exercise is imposed with the Brennan-Schwartz algorithm, a Thomas
+// solve with projection onto the payoff, or projected SOR.
+// All buffers are kept by the solver so repeated solves do not allocate.
+//
+//	pde::crank_nicolson cn(200, 100);
+//	double p = pde::value(cn, S, sigma, option::PUT, k, t, curve, pde::AMERICAN);
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "fms_option.h"
+#include "fms_pwflat.h"
+
+namespace fms::pde {
+
+	// Solve a[i] x[i-1] + b[i] x[i] + c[i] x[i+1] = d[i], 0 <= i < n,
+	// with a[0] and c[n-1] unused. The solution replaces d and w is scratch of size n.
+	inline void thomas(size_t n, const double* a, const double* b, const double* c, double* d, double* w)
+	{
+		if (n == 0) {
+			return;
+		}
+
+		w[0] = c[0] / b[0];
+		d[0] = d[0] / b[0];
+		for (size_t i = 1; i < n; ++i) {
+			double m = b[i] - a[i] * w[i - 1];
+			w[i] = c[i] / m;
+			d[i] = (d[i] - a[i] * d[i - 1]) / m;
+		}
+		for (size_t i = n - 1; i-- > 0; ) {
+			d[i] -= w[i] * d[i + 1];
+		}
+	}
+
+	// Solve the tridiagonal system subject to x >= g when the exercise region is
+	// a single interval at the low end (puts, low = true) or the high end (calls).
+	// Eliminate towards the exercise boundary and project while substituting back.
+	inline void brennan_schwartz(size_t n, const double* a, const double* b, const double* c, double* d, double* w,
+		const double* g, bool low)
+	{
+		if (n == 0) {
+			return;
+		}
+
+		if (low) {
+			w[n - 1] = a[n - 1] / b[n - 1];
+			d[n - 1] = d[n - 1] / b[n - 1];
+			for (size_t i = n - 1; i-- > 0; ) {
+				double m = b[i] - c[i] * w[i + 1];
+				w[i] = a[i] / m;
+				d[i] = (d[i] - c[i] * d[i + 1]) / m;
+			}
+			d[0] = std::max(d[0], g[0]);
+			for (size_t i = 1; i < n; ++i) {
+				d[i] = std::max(d[i] - w[i] * d[i - 1], g[i]);
+			}
+		}
+		else {
+			w[0] = c[0] / b[0];
+			d[0] = d[0] / b[0];
+			for (size_t i = 1; i < n; ++i) {
+				double m = b[i] - a[i] * w[i - 1];
+				w[i] = c[i] / m;
+				d[i] = (d[i] - a[i] * d[i - 1]) / m;
+			}
+			d[n - 1] = std::max(d[n - 1], g[n - 1]);
+			for (size_t i = n - 1; i-- > 0; ) {
+				d[i] = std::max(d[i] - w[i] * d[i + 1], g[i]);
+			}
+		}
+	}
+
+	// Projected successive over relaxation for the tridiagonal system subject to x >= g
+	// starting from x. Return the number of sweeps or 0 if not converged.
+	inline unsigned psor(size_t n, const double* a, const double* b, const double* c, const double* d,
+		const double* g, double* x, double omega = 1.2, double tol = 1e-10, unsigned iter = 1000)
+	{
+		for (unsigned k = 1; k <= iter; ++k) {
+			double dx = 0;
+			for (size_t i = 0; i < n; ++i) {
+				double r = d[i] - b[i] * x[i];
+				if (i > 0) {
+					r -= a[i] * x[i - 1];
+				}
+				if (i + 1 < n) {
+					r -= c[i] * x[i + 1];
+				}
+				double xi = std::max(x[i] + omega * r / b[i], g[i]);
+				dx = std::max(dx, fabs(xi - x[i]));
+				x[i] = xi;
+			}
+			if (dx <= tol) {
+				return k;
+			}
+		}
+
+		return 0;
+	}
+
+	enum exercise {
+		EUROPEAN,
+		AMERICAN,      // Brennan-Schwartz
+		AMERICAN_PSOR, // projected SOR
+	};
+
+	class crank_nicolson {
+		size_t m, n; // space intervals and time steps
+		unsigned rannacher; // number of initial steps replaced by two implicit half steps
+		double width; // standard deviations beyond the spot range
+		double x0, h; // x[i] = x0 + i h
+		std::vector<double> S, V, g, a, b, c, d, w;
+
+		// Advance V by dtau with rate r and implicitness theta given the new boundary
+		// values V0 and Vm. On entry V[0] and V[m] are the old boundary values.
+		void step(double dtau, double r, double sigma, double theta, double V0, double Vm, exercise e, bool low)
+		{
+			double s2 = sigma * sigma;
+			double alpha = s2 / (2 * h * h);
+			double beta = (r - s2 / 2) / (2 * h);
+			double l = alpha - beta, dd = -2 * alpha - r, u = alpha + beta;
+
+			for (size_t i = 1; i < m; ++i) {
+				a[i] = -theta * dtau * l;
+				b[i] = 1 - theta * dtau * dd;
+				c[i] = -theta * dtau * u;
+				d[i] = V[i] + (1 - theta) * dtau * (l * V[i - 1] + dd * V[i] + u * V[i + 1]);
+			}
+			V[0] = V0;
+			V[m] = Vm;
+			d[1] -= a[1] * V0;
+			d[m - 1] -= c[m - 1] * Vm;
+
+			// interior points 1, ..., m - 1
+			size_t k = m - 1;
+			double* a_ = a.data() + 1, * b_ = b.data() + 1, * c_ = c.data() + 1, * d_ = d.data() + 1;
+			if (e == AMERICAN_PSOR) {
+				psor(k, a_, b_, c_, d_, g.data() + 1, V.data() + 1);
+			}
+			else {
+				if (e == AMERICAN) {
+					brennan_schwartz(k, a_, b_, c_, d_, w.data() + 1, g.data() + 1, low);
+				}
+				else {
+					thomas(k, a_, b_, c_, d_, w.data() + 1);
+				}
+				std::copy(d_, d_ + k, V.data() + 1);
+			}
+		}
+		// derivative o of V with respect to s by quadratic interpolation in log s
+		double interpolate(double s, int o) const
+		{
+			double y = (log(s) - x0) / h;
+			if (!(0 <= y && y <= m)) {
+				return NaN;
+			}
+
+			size_t i = std::clamp<size_t>(static_cast<size_t>(y + 0.5), 1, m - 1);
+			double u = y - i; // in units of h
+			double V1 = (V[i + 1] - V[i - 1]) / 2, V2 = V[i + 1] - 2 * V[i] + V[i - 1];
+			if (o == 0) {
+				return V[i] + u * (V1 + u * V2 / 2);
+			}
+
+			// derivatives in x then convert to s
+			double Vx = (V1 + u * V2) / h;
+			if (o == 1) {
+				return Vx / s;
+			}
+			double Vxx = V2 / (h * h);
+
+			return (Vxx - Vx) / (s * s);
+		}
+	public:
+		// m space intervals, n time steps
+		crank_nicolson(size_t m = 200, size_t n = 100, unsigned rannacher = 2, double width = 5)
+			: m(std::max<size_t>(m, 2)), n(std::max<size_t>(n, 1)), rannacher(rannacher), width(width), x0(NaN), h(NaN),
+			S(this->m + 1), V(this->m + 1), g(this->m + 1), a(this->m + 1), b(this->m + 1), c(this->m + 1), d(this->m + 1), w(this->m + 1)
+		{ }
+
+		// number of grid points
+		size_t size() const
+		{
+			return m + 1;
+		}
+		// grid spots and values at time 0 of the last solve
+		const std::vector<double>& spots() const
+		{
+			return S;
+		}
+		const std::vector<double>& values() const
+		{
+			return V;
+		}
+
+		// Solve for payoff nu(S_t) at expiration t on a grid covering [S_lo, S_hi]
+		// and width standard deviations of log S on either side. Return the number of grid points.
+		template<class Nu>
+		size_t solve(double S_lo, double S_hi, double sigma, double t, const pwflat::curve<>& f, Nu&& nu, exercise e = EUROPEAN)
+		{
+			if (!(0 < S_lo && S_lo <= S_hi && sigma > 0 && t > 0)) {
+				x0 = h = NaN;
+
+				return 0;
+			}
+
+			double dx = width * sigma * sqrt(t);
+			x0 = log(S_lo) - dx;
+			h = (log(S_hi) + dx - x0) / m;
+			for (size_t i = 0; i <= m; ++i) {
+				S[i] = exp(x0 + i * h);
+				g[i] = nu(S[i]);
+				V[i] = g[i];
+			}
+			bool low = g[0] > g[m]; // exercise region at low spots
+
+			// R(tau) = int_{t - tau}^t r(u) du
+			double It = f.integral(t);
+			auto R = [&](double tau) { return It - f.integral(std::max(t - tau, 0.)); };
+			// boundary value at tau is the discounted payoff at the forward
+			auto boundary = [&](double tau, size_t i) {
+				double D = exp(-R(tau));
+				double v = D * nu(S[i] / D);
+
+				return e == EUROPEAN ? v : std::max(v, g[i]);
+			};
+
+			double dtau = t / n;
+			for (size_t j = 0; j < n; ++j) {
+				double tau0 = j * dtau;
+				if (j < rannacher) {
+					for (double tau : { tau0 + dtau / 2, tau0 + dtau }) {
+						double r = (R(tau) - R(tau - dtau / 2)) / (dtau / 2);
+						step(dtau / 2, r, sigma, 1, boundary(tau, 0), boundary(tau, m), e, low);
+					}
+				}
+				else {
+					double r = (R(tau0 + dtau) - R(tau0)) / dtau;
+					step(dtau, r, sigma, 0.5, boundary(tau0 + dtau, 0), boundary(tau0 + dtau, m), e, low);
+				}
+			}
+
+			return m + 1;
+		}
+
+		// value, delta, and gamma at spot s by quadratic interpolation in log s on the last solve
+		double value(double s) const
+		{
+			return interpolate(s, 0);
+		}
+		double delta(double s) const
+		{
+			return interpolate(s, 1);
+		}
+		double gamma(double s) const
+		{
+			return interpolate(s, 2);
+		}
+	};
+
+	// payoff of contract c with strike k at expiration
+	struct payoff {
+		option::contract c;
+		double k;
+
+		double operator()(double S) const
+		{
+			switch (c) {
+			case option::PUT:
+				return std::max(k - S, 0.);
+			case option::CALL:
+				return std::max(S - k, 0.);
+			case option::DIGITAL_PUT:
+				return 1. * (S <= k);
+			case option::DIGITAL_CALL:
+				return 1. * (S > k);
+			}
+
+			return NaN;
+		}
+	};
+
+	// Value of contract c with strike k and expiration t at spot S.
+	inline double value(crank_nicolson& cn, double S, double sigma, option::contract c, double k, double t,
+		const pwflat::curve<>& f, exercise e = EUROPEAN)
+	{
+		if (!(k > 0) || !cn.solve(S, S, sigma, t, f, payoff{ c, k }, e)) {
+			return NaN;
+		}
+
+		return cn.value(S);
+	}
+
+	// Values V[i] of contract c with strikes k[i] from one solve with unit strike
+	// using V(S, k) = k V(S/k, 1) for puts and calls and V(S, k) = V(S/k, 1) for digitals.
+	// Return the number of strikes.
+	inline size_t value(crank_nicolson& cn, double S, double sigma, option::contract c, size_t nk, const double* k,
+		double t, const pwflat::curve<>& f, exercise e, double* V)
+	{
+		if (nk == 0) {
+			return 0;
+		}
+
+		auto [k_lo, k_hi] = std::minmax_element(k, k + nk);
+		if (!(*k_lo > 0) || !cn.solve(S / *k_hi, S / *k_lo, sigma, t, f, payoff{ c, 1 }, e)) {
+			std::fill(V, V + nk, NaN);
+
+			return 0;
+		}
+
+		bool digital = c == option::DIGITAL_PUT || c == option::DIGITAL_CALL;
+		for (size_t i = 0; i < nk; ++i) {
+			V[i] = (digital ? 1 : k[i]) * cn.value(S / k[i]);
+		}
+
+		return nk;
+	}
+
+} // namespace fms::pde
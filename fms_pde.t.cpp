@@ -0,0 +1,119 @@
+// fms_pde.t.cpp - Test finite difference option pricing
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include "fms_pde.h"
+#include "fms_variate_normal.h"
+
+using namespace fms;
+
+int pde_thomas_test()
+{
+	{
+		// 2 x0 + x1 = 3, x0 + 2 x1 + x2 = 4, x1 + 2 x2 = 3 has solution 1, 1, 1
+		double a[] = { 0, 1, 1 }, b[] = { 2, 2, 2 }, c[] = { 1, 1, 0 };
+		double d[] = { 3, 4, 3 }, w[3];
+		pde::thomas(3, a, b, c, d, w);
+		for (double x : d) {
+			assert(fabs(x - 1) < 1e-15);
+		}
+	}
+	{
+		// projection onto g
+		double a[] = { 0, 1, 1 }, b[] = { 2, 2, 2 }, c[] = { 1, 1, 0 };
+		double g[] = { 1.5, 0, 0 };
+		for (bool low : { true, false }) {
+			double d[] = { 3, 4, 3 }, w[3];
+			pde::brennan_schwartz(3, a, b, c, d, w, g, low);
+			for (int i = 0; i < 3; ++i) {
+				assert(d[i] >= g[i]);
+			}
+		}
+		double x[] = { 1, 1, 1 }, d[] = { 3, 4, 3 };
+		assert(pde::psor(3, a, b, c, d, g, x) > 0);
+		assert(x[0] == 1.5);
+	}
+
+	return 0;
+}
+int pde_thomas_test_ = pde_thomas_test();
+
+int pde_european_test()
+{
+	variate::normal N;
+	double r = 0.05, S = 100, s = 0.2, k = 100, t = 1;
+	pwflat::curve<> f(r);
+
+	{
+		// second order convergence
+		double e[2];
+		for (size_t j : { 0, 1 }) {
+			pde::crank_nicolson cn(100 << j, 50 << j);
+			double p = pde::value(cn, S, s, option::PUT, k, t, f);
+			e[j] = p - option::bsm::value(N, r, S, s, option::PUT, k, t);
+		}
+		assert(fabs(e[1]) < 3e-3);
+		assert(3 < e[0] / e[1] && e[0] / e[1] < 5);
+	}
+	{
+		pde::crank_nicolson cn(400, 200);
+		for (option::contract c : { option::PUT, option::CALL }) {
+			for (double k_ : { 80., 100., 120. }) {
+				double v = pde::value(cn, S, s, c, k_, t, f);
+				assert(fabs(v - option::bsm::value(N, r, S, s, c, k_, t)) < 1e-3);
+				assert(fabs(cn.delta(S) - option::bsm::delta(N, r, S, s, c, k_, t)) < 1e-4);
+				assert(fabs(cn.gamma(S) - option::bsm::gamma(N, r, S, s, c, k_, t)) < 1e-4);
+			}
+		}
+		double d = pde::value(cn, S, s, option::DIGITAL_CALL, k, t, f);
+		assert(fabs(d - option::bsm::value(N, r, S, s, option::DIGITAL_CALL, k, t)) < 1e-2);
+	}
+	{
+		// European values only depend on the integral of the forward curve
+		double u[] = { 0.25, 0.5, 2 }, fu[] = { 0.01, 0.03, 0.06 };
+		pwflat::curve<> g(3, u, fu, 0.06);
+		pde::crank_nicolson cn(400, 200);
+		double p = pde::value(cn, S, s, option::PUT, k, t, g);
+		assert(fabs(p - option::bsm::value(N, g.spot(t), S, s, option::PUT, k, t)) < 1e-3);
+	}
+
+	return 0;
+}
+int pde_european_test_ = pde_european_test();
+
+int pde_american_test()
+{
+	double r = 0.05, S = 100, s = 0.2, k = 100, t = 1;
+	pwflat::curve<> f(r);
+	pde::crank_nicolson cn(400, 200);
+
+	{
+		double p = pde::value(cn, S, s, option::PUT, k, t, f);
+		double P = pde::value(cn, S, s, option::PUT, k, t, f, pde::AMERICAN);
+		double P_ = pde::value(cn, S, s, option::PUT, k, t, f, pde::AMERICAN_PSOR);
+		assert(P > p);
+		assert(fabs(P - 6.0903) < 2e-3); // reference value
+		assert(fabs(P - P_) < 1e-6);
+		// early exercise region
+		assert(cn.values()[1] == k - cn.spots()[1]);
+	}
+	{
+		// never optimal to exercise a call without dividends
+		double c = pde::value(cn, S, s, option::CALL, k, t, f);
+		double C = pde::value(cn, S, s, option::CALL, k, t, f, pde::AMERICAN);
+		assert(fabs(C - c) < 1e-12);
+	}
+	{
+		// strike grid from one solve
+		double K[] = { 80, 90, 100, 110, 120 }, V[5];
+		assert(5 == pde::value(cn, S, s, option::PUT, 5, K, t, f, pde::AMERICAN, V));
+		for (int i = 0; i < 5; ++i) {
+			assert(fabs(V[i] - pde::value(cn, S, s, option::PUT, K[i], t, f, pde::AMERICAN)) < 1e-3);
+		}
+	}
+
+	return 0;
+}
+int pde_american_test_ = pde_american_test();
+
+#endif // _DEBUG
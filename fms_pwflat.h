@@ -4,7 +4,9 @@
 #include <cassert>
 #endif
 #include <algorithm>
+#include <cmath>
 #include <limits>
+#include <utility>
 #include <vector>
 /*
 		   { f[i] if t[i-1] < t <= t[i];
@@ -74,11 +76,44 @@ namespace fms::pwflat {
 			I += f[i] * (t[i] - t_);
 			t_ = t[i];
 		}
-		I += (n == 0 || u > t[n - 1] ? _f : f[i]) * (u - t_);
+		if (u > t_) {
+			I += (i == n ? _f : f[i]) * (u - t_);
+		}
 
 		return I;
 	}
 
+	// I[i] = int_0^{t[i]} f(t) dt, 0 <= i < n
+	template<class T, class F>
+	inline void cumulative_integral(size_t n, const T* t, const F* f, F* I)
+	{
+		F I_ = 0;
+		T t_ = 0;
+
+		for (size_t i = 0; i < n; ++i) {
+			I_ += f[i] * (t[i] - t_);
+			I[i] = I_;
+			t_ = t[i];
+		}
+	}
+
+	// int_0^u f(t) dt using cumulative integrals I from cumulative_integral
+	template<class T, class F>
+	inline F integral(T u, size_t n, const T* t, const F* f, const F* I, F _f = NaN<F>)
+	{
+		if (u < 0)
+			return NaN<F>;
+
+		// first element in t >= u
+		size_t i = std::lower_bound(t, t + n, u) - t;
+
+		if (i == n) {
+			return n == 0 ? _f * u : I[n - 1] + _f * (u - t[n - 1]);
+		}
+
+		return i == 0 ? f[0] * u : I[i - 1] + f[i] * (u - t[i - 1]);
+	}
+
 #ifdef _DEBUG
 	inline int integral_test()
 	{
@@ -97,6 +132,15 @@ namespace fms::pwflat {
 		assert(integral(2.5, 3, t, f) == f[0] * 1.0 + f[1] * 1.0 + f[2] * 0.5);
 		assert(integral(3.0, 3, t, f) == f[0] * 1.0 + f[1] * 1.0 + f[2] * 1.0);
 		assert(integral(3.5, 3, t, f, 4.0) == f[0] * 1.0 + f[1] * 1.0 + f[2] * 1.0 + 4.0 * 0.5);
+
+		// cumulative integrals give the same result
+		double I[3];
+		cumulative_integral(3, t, f, I);
+		assert(_isnan(integral(-0.5, 3, t, f, I)));
+		for (double u : { 0., 0.5, 1., 1.5, 2., 2.5, 3., 3.5 }) {
+			assert(fabs(integral(u, 3, t, f, I, 4.) - integral(u, 3, t, f, 4.)) <= 1e-15);
+		}
+		assert(integral(1.5, 0, t, f, I, 4.) == 4. * 1.5);
 		
 		return 0;
 	}
@@ -139,58 +183,580 @@ namespace fms::pwflat {
 		return 0;
 	}
 
+#endif // _DEBUG
+
+	// Sensitivities with respect to f[i], 0 <= i <= n, where f[n] = _f.
+	// d/df[i] int_0^u f(t) dt is the length of [0, u] intersected with (t[i-1], t[i]]
+	// so only the first segments through the one containing u are nonzero.
+	// Each function writes those entries and returns how many there are.
+
+	// dI[i] = d/df[i] int_0^u f(t) dt
+	template<class T, class F>
+	inline size_t integral_gradient(T u, size_t n, const T* t, F* dI)
+	{
+		if (u < 0) {
+			return 0;
+		}
+
+		size_t i = 0;
+		T t_ = 0;
+		while (i < n && t[i] < u) {
+			dI[i] = t[i] - t_;
+			t_ = t[i];
+			++i;
+		}
+		dI[i] = u - t_;
+
+		return i + 1;
+	}
+
+	// dD[i] = d/df[i] exp(-int_0^u f(t) dt) = -D(u) dI[i]
+	template<class T, class F>
+	inline size_t discount_gradient(T u, size_t n, const T* t, const F* f, F* dD, F _f = NaN<F>)
+	{
+		size_t k = integral_gradient(u, n, t, dD);
+		F D = discount(u, n, t, f, _f);
+		for (size_t i = 0; i < k; ++i) {
+			dD[i] *= -D;
+		}
+
+		return k;
+	}
+
+	// dr[i] = d/df[i] (1/u) int_0^u f(t) dt
+	template<class T, class F>
+	inline size_t spot_gradient(T u, size_t n, const T* t, F* dr)
+	{
+		if (u == 0) {
+			dr[0] = 1;
+
+			return 1;
+		}
+
+		size_t k = integral_gradient(u, n, t, dr);
+		for (size_t i = 0; i < k; ++i) {
+			dr[i] /= u;
+		}
+
+		return k;
+	}
+
+#ifdef _DEBUG
+
+	inline int gradient_test()
+	{
+		double t[] = { 1,2,3 };
+		double f[] = { .1,.2,.3 };
+		double _f = .4;
+		double h = 1e-6;
+
+		for (double u : { 0., 0.5, 1., 1.5, 3., 3.5 }) {
+			double dI[4], dD[4], dr[4];
+			size_t k = integral_gradient(u, 3, t, dI);
+			assert(k == discount_gradient(u, 3, t, f, dD, _f));
+			assert(k == spot_gradient(u, 3, t, dr));
+			for (size_t i = 0; i < 4; ++i) {
+				double fp[] = { f[0], f[1], f[2], _f };
+				double fm[] = { f[0], f[1], f[2], _f };
+				fp[i] += h;
+				fm[i] -= h;
+				double dI_ = (integral(u, 3, t, fp, fp[3]) - integral(u, 3, t, fm, fm[3])) / (2 * h);
+				double dD_ = (discount(u, 3, t, fp, fp[3]) - discount(u, 3, t, fm, fm[3])) / (2 * h);
+				double dr_ = (spot(u, 3, t, fp, fp[3]) - spot(u, 3, t, fm, fm[3])) / (2 * h);
+				assert(fabs((i < k ? dI[i] : 0) - dI_) < 1e-9);
+				assert(fabs((i < k ? dD[i] : 0) - dD_) < 1e-9);
+				assert(fabs((i < k ? dr[i] : 0) - dr_) < 1e-9);
+			}
+		}
+
+		return 0;
+	}
+
+#endif // _DEBUG
+
+	// Sorted batch evaluation at u[0] <= u[1] <= ... <= u[m-1].
+	// Knots and query times are merged in one pass so the cost is O(n + m).
+
+	// fu[j] = f(u[j]) and Iu[j] = int_0^{u[j]} f(t) dt, 0 <= j < m
+	// Either output can be null.
+	template<class T, class F>
+	inline void values(size_t m, const T* u, size_t n, const T* t, const F* f,
+		F* fu, F* Iu, F _f = NaN<F>)
+	{
+		size_t i = 0;
+		F I = 0;
+		T t_ = 0;
+
+		for (size_t j = 0; j < m; ++j) {
+			if (u[j] < 0) {
+				if (fu) fu[j] = NaN<F>;
+				if (Iu) Iu[j] = NaN<F>;
+
+				continue;
+			}
+			// advance to first t[i] >= u[j]
+			while (i < n && t[i] < u[j]) {
+				I += f[i] * (t[i] - t_);
+				t_ = t[i];
+				++i;
+			}
+
+			F fi = i == n ? _f : f[i];
+			if (fu) fu[j] = fi;
+			if (Iu) Iu[j] = u[j] > t_ ? I + fi * (u[j] - t_) : I;
+		}
+	}
+
+	// fu[j] = f(u[j])
+	template<class T, class F>
+	inline void value(size_t m, const T* u, size_t n, const T* t, const F* f, F* fu, F _f = NaN<F>)
+	{
+		values<T, F>(m, u, n, t, f, fu, nullptr, _f);
+	}
+
+	// Iu[j] = int_0^{u[j]} f(t) dt
+	template<class T, class F>
+	inline void integral(size_t m, const T* u, size_t n, const T* t, const F* f, F* Iu, F _f = NaN<F>)
+	{
+		values<T, F>(m, u, n, t, f, nullptr, Iu, _f);
+	}
+
+	// D[j] = exp(-int_0^{u[j]} f(t) dt)
+	template<class T, class F>
+	inline void discount(size_t m, const T* u, size_t n, const T* t, const F* f, F* D, F _f = NaN<F>)
+	{
+		integral<T, F>(m, u, n, t, f, D, _f);
+		// separate loop so exp vectorizes
+		for (size_t j = 0; j < m; ++j) {
+			D[j] = exp(-D[j]);
+		}
+	}
+
+#ifdef _DEBUG
+
+	inline int batch_test()
+	{
+		double t[] = { 1,2,3 };
+		double f[] = { .1,.2,.3 };
+		double u[] = { -1, 0, 0.5, 1, 1, 1.5, 2, 2.5, 3, 3.5, 10 };
+		constexpr size_t m = sizeof(u) / sizeof(*u);
+		double fu[m], Iu[m], D[m];
+
+		values(m, u, 3, t, f, fu, Iu, 4.);
+		discount(m, u, 3, t, f, D, 4.);
+		assert(_isnan(fu[0]) && _isnan(Iu[0]) && _isnan(D[0]));
+		for (size_t j = 1; j < m; ++j) {
+			assert(fu[j] == value(u[j], 3, t, f, 4.));
+			assert(fabs(Iu[j] - integral(u[j], 3, t, f, 4.)) <= 1e-15);
+			assert(fabs(D[j] - discount(u[j], 3, t, f, 4.)) <= 1e-15);
+		}
+
+		return 0;
+	}
+
+#endif // _DEBUG
+
+	// Eytzinger (BFS) layout of sorted times for branchless, cache friendly search.
+	// Node k has children 2k and 2k + 1 so the top levels share cache lines.
+	// Store data needed after the search in node order to avoid another cache miss.
+	// See https://arxiv.org/abs/1509.05053
+	template<class T = double>
+	class eytzinger {
+		std::vector<T> e;       // e[k], 1 <= k <= n, e[0] unused
+		std::vector<size_t> i_; // e[k] = t[i_[k]]
+
+		void build(const T* t, size_t& i, size_t k)
+		{
+			if (k < e.size()) {
+				build(t, i, 2 * k);
+				e[k] = t[i];
+				i_[k] = i++;
+				build(t, i, 2 * k + 1);
+			}
+		}
+	public:
+		eytzinger(size_t n = 0, const T* t = nullptr)
+			: e(n + 1), i_(n + 1)
+		{
+			size_t i = 0;
+			build(t, i, 1);
+			i_[0] = n;
+		}
+		eytzinger(const eytzinger&) = default;
+		eytzinger& operator=(const eytzinger&) = default;
+		~eytzinger()
+		{ }
+
+		size_t size() const
+		{
+			return e.size() - 1;
+		}
+
+		// node of first element in t >= u, or 0 if none
+		size_t node(T u) const
+		{
+			size_t n = size();
+			size_t k = 1;
+
+			while (k <= n) {
+				k = 2 * k + (e[k] < u);
+			}
+			// undo right turns and the last left turn
+			while (k & 1) {
+				k >>= 1;
+			}
+
+			return k >> 1;
+		}
+
+		// index in t of node k, or n if k = 0
+		size_t index(size_t k) const
+		{
+			return i_[k];
+		}
+
+		// index of first element in t >= u, or n if none
+		size_t lower_bound(T u) const
+		{
+			return index(node(u));
+		}
+	};
+
+#ifdef _DEBUG
+
+	inline int eytzinger_test()
+	{
+		for (size_t n : {0, 1, 2, 3, 7, 8, 100}) {
+			std::vector<double> t(n);
+			for (size_t i = 0; i < n; ++i) {
+				t[i] = 1. + i;
+			}
+			eytzinger e(n, t.data());
+			assert(e.size() == n);
+			for (double u = -0.5; u <= n + 1.; u += 0.25) {
+				size_t i = std::lower_bound(t.begin(), t.end(), u) - t.begin();
+				assert(e.lower_bound(u) == i);
+			}
+		}
+
+		return 0;
+	}
+
 #endif // _DEBUG
 
 	// pwflat forward value type
+	// Cumulative integrals at each knot make integral, discount, and spot O(log n).
 	template<class T = double, class F = double>
 	class curve {
 		std::vector<T> t;
 		std::vector<F> f;
+		std::vector<F> I; // I[i] = int_0^{t[i]} f(s) ds
 		F _f;
+		// optional search layout with knot data in node order
+		struct knot {
+			F f;  // forward on (t_, t]
+			T t_; // previous knot time
+			F I;  // integral to t_
+		};
+		bool layout = false; // use e and k when not stale
+		eytzinger<T> e;
+		std::vector<knot> k;
+
+		// forward and integral at u >= 0
+		knot find(T u) const
+		{
+			size_t n = t.size();
+
+			if (!k.empty()) {
+				return k[e.node(u)];
+			}
+
+			size_t i = std::lower_bound(t.begin(), t.end(), u) - t.begin();
+
+			return i == n
+				? knot{ _f, n ? t[n - 1] : 0, n ? I[n - 1] : 0 }
+				: knot{ f[i], i ? t[i - 1] : 0, i ? I[i - 1] : 0 };
+		}
 	public:
 		// default constructable
 		curve(F _f = NaN<F>)
 			: _f(_f)
 		{ }
 		curve(size_t n, const T* t, const F* f, F _f = NaN<F>)
-			: t(t, t + n), f(f, f + n), _f(_f)
-		{ }
+			: t(t, t + n), f(f, f + n), I(n), _f(_f)
+		{
+			cumulative_integral(n, t, f, I.data());
+		}
 		curve(const curve&) = default;
 		curve& operator=(const curve&) = default;
 		~curve()
 		{ }
 
+		size_t size() const
+		{
+			return t.size();
+		}
+		// last knot time and integral to it, or zeros if no knots
+		std::pair<T, F> back() const
+		{
+			return t.size() ? std::pair<T, F>(t.back(), I.back()) : std::pair<T, F>(0, 0);
+		}
+		// set extrapolated value
+		curve& extrapolate(F f_)
+		{
+			_f = f_;
+			if (!k.empty()) {
+				// node 0 is past the last knot
+				size_t n = t.size();
+				k[0] = knot{ _f, n ? t[n - 1] : 0, n ? I[n - 1] : 0 };
+			}
+
+			return *this;
+		}
+
+		// Use Eytzinger layout for searching large curves.
+		// Extending the curve makes the layout stale and lookups use binary search
+		// until search() rebuilds it, so extend in a batch then call search() once.
+		curve& search(bool eytzinger_layout)
+		{
+			layout = eytzinger_layout;
+			e = eytzinger<T>{};
+			k.clear();
+
+			return search();
+		}
+		// Rebuild a stale layout.
+		curve& search()
+		{
+			if (layout && k.empty()) {
+				size_t n = t.size();
+
+				e = eytzinger<T>(n, t.data());
+				k.resize(n + 1);
+				for (size_t j = 0; j <= n; ++j) {
+					size_t i = e.index(j);
+					k[j] = i == n
+						? knot{ _f, n ? t[n - 1] : 0, n ? I[n - 1] : 0 }
+						: knot{ f[i], i ? t[i - 1] : 0, i ? I[i - 1] : 0 };
+				}
+			}
+
+			return *this;
+		}
+
 		curve& extend(T t_, F f_)
 		{
 			// ensure(t_ > t.back());
+			I.push_back(t.size() ? I.back() + f_ * (t_ - t.back()) : f_ * t_);
 			t.push_back(t_);
 			f.push_back(f_);
+			k.clear(); // stale layout
 
 			return *this;
 		}
 
 		F forward(T u) const
 		{
-			return value(u, t.size(), t.data(), f.data(), _f);
+			return u < 0 ? NaN<F> : find(u).f;
 		}
 		F integral(T u) const
 		{
-			return integral(u, t.size(), t.data(), f.data(), _f);
+			if (u < 0) {
+				return NaN<F>;
+			}
+
+			knot k_ = find(u);
+
+			return k_.I + k_.f * (u - k_.t_);
 		}
 		F spot(T u) const
 		{
-			return spot(u, t.size(), t.data(), f.data(), _f);
+			if (u < 0) {
+				return NaN<F>;
+			}
+			if (t.size() == 0) {
+				return _f;
+			}
+
+			return u <= t[0] ? f[0] : integral(u) / u;
 		}
 		F discount(T u) const
 		{
-			return discount(u, t.size(), t.data(), f.data(), _f);
+			return exp(-integral(u));
+		}
+
+		// Batch versions for sorted u[0] <= ... <= u[m-1] in O(n + m).
+		void forward(size_t m, const T* u, F* fu) const
+		{
+			values(m, u, fu, nullptr);
+		}
+		void integral(size_t m, const T* u, F* Iu) const
+		{
+			values(m, u, nullptr, Iu);
+		}
+		void discount(size_t m, const T* u, F* D) const
+		{
+			values(m, u, nullptr, D);
+			for (size_t j = 0; j < m; ++j) {
+				D[j] = exp(-D[j]);
+			}
+		}
+		// fu[j] = f(u[j]), Iu[j] = int_0^{u[j]} f using the cached integrals
+		void values(size_t m, const T* u, F* fu, F* Iu) const
+		{
+			size_t n = t.size();
+			size_t i = 0;
+
+			for (size_t j = 0; j < m; ++j) {
+				if (u[j] < 0) {
+					if (fu) fu[j] = NaN<F>;
+					if (Iu) Iu[j] = NaN<F>;
+
+					continue;
+				}
+				while (i < n && t[i] < u[j]) {
+					++i;
+				}
+
+				F fi = i == n ? _f : f[i];
+				if (fu) fu[j] = fi;
+				if (Iu) {
+					Iu[j] = i == 0 ? fi * u[j] : I[i - 1] + fi * (u[j] - t[i - 1]);
+				}
+			}
+		}
+
+		// Sensitivities with respect to f[i], 0 <= i <= n, where f[n] = _f.
+		// Returns the number of leading nonzero entries.
+		size_t integral_gradient(T u, F* dI) const
+		{
+			return pwflat::integral_gradient(u, t.size(), t.data(), dI);
+		}
+		size_t discount_gradient(T u, F* dD) const
+		{
+			size_t k = integral_gradient(u, dD);
+			F D = discount(u);
+			for (size_t i = 0; i < k; ++i) {
+				dD[i] *= -D;
+			}
+
+			return k;
+		}
+		size_t spot_gradient(T u, F* dr) const
+		{
+			return pwflat::spot_gradient(u, t.size(), t.data(), dr);
+		}
+
+		// Return pv = sum_j c[j] D(u[j]) for sorted u and set dpv[i] = d pv/df[i], 0 <= i <= n.
+		// Sweep segments from the right keeping the present value of later cash flows
+		// so dpv[i] = -(tail pv) (t[i] - t[i-1]) - sum_{u[j] in segment i} c[j] D(u[j]) (u[j] - t[i-1]).
+		F present_value(size_t m, const T* u, const F* c, F* dpv = nullptr) const
+		{
+			size_t n = t.size();
+			size_t i = n;
+			F pv = 0;
+
+			if (m > 0 && u[0] < 0) {
+				return NaN<F>;
+			}
+			if (dpv) {
+				dpv[n] = 0;
+			}
+			for (size_t j = m; j-- > 0; ) {
+				// move to segment containing u[j]
+				while (i > 0 && u[j] <= t[i - 1]) {
+					--i;
+					if (dpv) {
+						dpv[i] = -pv * (t[i] - (i ? t[i - 1] : 0));
+					}
+				}
+
+				T t_ = i ? t[i - 1] : 0;
+				F fi = i == n ? _f : f[i];
+				F cD = c[j] * exp(-((i ? I[i - 1] : 0) + fi * (u[j] - t_)));
+				if (dpv) {
+					dpv[i] -= cD * (u[j] - t_);
+				}
+				pv += cD;
+			}
+			while (i > 0) {
+				--i;
+				if (dpv) {
+					dpv[i] = -pv * (t[i] - (i ? t[i - 1] : 0));
+				}
+			}
+
+			return pv;
 		}
 
 #ifdef _DEBUG
-		int test()
+		static int test()
 		{
 			{
 				curve c;
+				assert(c.size() == 0);
+				assert(_isnan(c.integral(1)));
+			}
+			{
+				T t_[] = { 1,2,3 };
+				F f_[] = { .1,.2,.3 };
+				curve c(3, t_, f_, F(.4));
+				curve d(F(.4));
+				for (int i : {0, 1, 2}) {
+					d.extend(t_[i], f_[i]);
+				}
+				T u_[] = { 0., 0.5, 1., 1.5, 2., 2.5, 3., 3.5 };
+				F D_[8];
+				c.discount(8, u_, D_);
+				for (size_t j = 0; j < 8; ++j) {
+					assert(fabs(D_[j] - c.discount(u_[j])) <= 1e-15);
+				}
+				curve e(c);
+				e.search(true);
+				for (T u : u_) {
+					assert(e.forward(u) == c.forward(u));
+					assert(e.integral(u) == c.integral(u));
+				}
+				{
+					// stale layout after extend until rebuilt
+					curve g(c), h(c);
+					g.search(true);
+					g.extend(4, F(.5)).extrapolate(F(.6));
+					h.extend(4, F(.5)).extrapolate(F(.6));
+					for (T u : { 0.5, 3.5, 4.5 }) {
+						assert(g.forward(u) == h.forward(u));
+					}
+					g.search();
+					g.extrapolate(F(.7));
+					h.extrapolate(F(.7));
+					for (T u : { 0.5, 3.5, 4.5 }) {
+						assert(g.forward(u) == h.forward(u));
+						assert(g.integral(u) == h.integral(u));
+					}
+				}
+				{
+					// present value gradient matches pointwise discount gradients
+					F c_[] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+					F dpv[4], dD[4];
+					F pv = c.present_value(8, u_, c_, dpv);
+					for (size_t i = 0; i < 4; ++i) {
+						F dpv_ = 0;
+						for (size_t j = 0; j < 8; ++j) {
+							size_t k = c.discount_gradient(u_[j], dD);
+							dpv_ += i < k ? c_[j] * dD[i] : 0;
+						}
+						assert(fabs(dpv[i] - dpv_) <= 1e-14);
+						pv -= c_[i] * c.discount(u_[i]) + c_[i + 4] * c.discount(u_[i + 4]);
+					}
+					assert(fabs(pv) <= 1e-14);
+				}
+				for (T u : u_) {
+					F I = pwflat::integral(u, 3, t_, f_, F(.4));
+					assert(fabs(c.integral(u) - I) <= 1e-15);
+					assert(fabs(d.integral(u) - I) <= 1e-15);
+					assert(c.discount(u) == exp(-c.integral(u)));
+					assert(fabs(c.spot(u) - pwflat::spot(u, 3, t_, f_, F(.4))) <= 1e-15);
+				}
 			}
 
 			return 0;
@@ -0,0 +1,239 @@
+// fms_pwflat_bootstrap.h - Bootstrap a piecewise flat forward curve
+// An instrument has price p and cash flows c[j] at times u[j] with
+// p = sum_j c[j] D(u[j]). If t_ is the last knot of the curve then
+// cash flows with u[j] <= t_ have known discount and the others have
+// D(u[j]) = D(t_) exp(-f (u[j] - t_)) where f is the forward on (t_, u[m-1]].
+// Solve for f using Newton's method and extend the curve to u[m-1].
+#pragma once
+#ifdef _DEBUG
+#include <cassert>
+#endif
+#include <cmath>
+#include <vector>
+#include "fms_pwflat.h"
+
+namespace fms::pwflat {
+
+	// price and sorted cash flows
+	template<class T = double, class F = double>
+	struct instrument {
+		F p;
+		std::vector<T> u;
+		std::vector<F> c;
+	};
+
+	// price 1 for 1 + r t at t
+	template<class T = double, class F = double>
+	inline instrument<T, F> deposit(T t, F r)
+	{
+		return instrument<T, F>{ F(1), { t }, { 1 + r * t } };
+	}
+
+	// price 0 for -1 at t0 and 1 + r (t1 - t0) at t1
+	template<class T = double, class F = double>
+	inline instrument<T, F> fra(T t0, T t1, F r)
+	{
+		return instrument<T, F>{ F(0), { t0, t1 }, { F(-1), 1 + r * (t1 - t0) } };
+	}
+
+	// price 1 for coupons r dt every 1/freq years with a short first period and 1 at maturity t
+	// No cash flows and NaN price unless t > 0 and freq > 0.
+	template<class T = double, class F = double>
+	inline instrument<T, F> swap(T t, F r, unsigned freq = 2)
+	{
+		if (!(t > 0) || freq == 0) {
+			return instrument<T, F>{ NaN<F>, {}, {} };
+		}
+
+		// number of payments allowing for roundoff in t freq
+		size_t n = static_cast<size_t>(ceil(t * freq - 1e-8));
+		instrument<T, F> i{ F(1), std::vector<T>(n), std::vector<F>(n) };
+
+		T u_ = 0;
+		for (size_t j = 0; j < n; ++j) {
+			i.u[j] = t - T(n - 1 - j) / freq;
+			i.c[j] = r * (i.u[j] - u_);
+			u_ = i.u[j];
+		}
+		i.c[n - 1] += 1;
+
+		return i;
+	}
+
+	// Forward on (t_, u[m-1]] with sum_j c[j] D(u[j]) = p, or NaN if not found.
+	// Known cash flows are discounted once, then each Newton step only uses
+	// the cash flows after the last knot.
+	template<class T, class F>
+	inline F bootstrap(const curve<T, F>& f, size_t m, const T* u, const F* c, F p,
+		F f_ = 0, F tol = 1e-15, unsigned iter = 100)
+	{
+		auto [t_, I_] = f.back();
+
+		// present value of cash flows on the curve
+		F pv = 0;
+		size_t j = 0;
+		while (j < m && u[j] <= t_) {
+			pv += c[j] * f.discount(u[j]);
+			++j;
+		}
+		if (j == m) {
+			return NaN<F>;
+		}
+
+		F D_ = exp(-I_);
+		while (iter--) {
+			// g(f) = pv + D(t_) sum_k c[k] exp(-f (u[k] - t_)) - p
+			F g = pv - p;
+			F dg = 0;
+			for (size_t k = j; k < m; ++k) {
+				T dt = u[k] - t_;
+				F ck = c[k] * D_ * exp(-f_ * dt);
+				g += ck;
+				dg -= ck * dt;
+			}
+
+			F df = g / dg;
+			f_ -= df;
+			if (!std::isfinite(f_)) {
+				return NaN<F>;
+			}
+			if (fabs(df) <= tol * (1 + fabs(f_))) {
+				return f_;
+			}
+		}
+
+		return NaN<F>;
+	}
+
+	// Extend f to the last cash flow of i and return the forward, or NaN if the last
+	// cash flow is not after the last knot or no forward is found. The curve is
+	// only extended if the forward is not NaN. Previous forward is the initial guess.
+	template<class T, class F>
+	inline F bootstrap(curve<T, F>& f, const instrument<T, F>& i)
+	{
+		auto [t_, I_] = f.back();
+		if (i.u.empty() || !(i.u.back() > t_)) {
+			return NaN<F>;
+		}
+
+		F f_ = f.size() ? f.forward(t_) : F(0);
+		f_ = bootstrap(f, i.u.size(), i.u.data(), i.c.data(), i.p, f_);
+		if (!std::isnan(f_)) {
+			f.extend(i.u.back(), f_);
+		}
+
+		return f_;
+	}
+
+	// Extend f using instruments sorted by last cash flow and return the number used.
+	// Stops at the first instrument that cannot be bootstrapped.
+	// A search layout is rebuilt once at the end.
+	template<class T, class F>
+	inline size_t bootstrap(curve<T, F>& f, size_t n, const instrument<T, F>* i)
+	{
+		size_t j = 0;
+		while (j < n && !std::isnan(bootstrap(f, i[j]))) {
+			++j;
+		}
+		f.search();
+
+		return j;
+	}
+
+#ifdef _DEBUG
+
+	// sum_j c[j] D(u[j]) - p
+	template<class T, class F>
+	inline F bootstrap_error(const curve<T, F>& f, const instrument<T, F>& i)
+	{
+		F pv = -i.p;
+		for (size_t j = 0; j < i.u.size(); ++j) {
+			pv += i.c[j] * f.discount(i.u[j]);
+		}
+
+		return pv;
+	}
+
+	inline int bootstrap_test()
+	{
+		{
+			curve<> f;
+			bootstrap(f, deposit(0.25, 0.05));
+			assert(f.size() == 1);
+			assert(fabs(f.forward(0.25) - log(1 + 0.05 * 0.25) / 0.25) < 1e-15);
+		}
+		{
+			auto s = swap(1.25, 0.04, 2);
+			assert(s.u.size() == 3);
+			assert(s.u[0] == 0.25 && s.u[2] == 1.25);
+			assert(fabs(s.c[0] - 0.04 * 0.25) < 1e-15);
+			assert(fabs(s.c[2] - (1 + 0.04 * 0.5)) < 1e-15);
+		}
+		{
+			// blank, negative, or NaN maturity
+			for (double t : { 0., -1., NaN<double> }) {
+				auto s = swap(t, 0.04, 2);
+				assert(s.u.empty() && s.c.empty() && s.p != s.p);
+				curve<> f;
+				assert(bootstrap(f, s) != bootstrap(f, s));
+				assert(f.size() == 0);
+			}
+			assert(swap(1., 0.04, 0).u.empty());
+		}
+		{
+			instrument<> is[] = {
+				deposit(0.25, 0.030),
+				fra(0.25, 0.5, 0.032),
+				deposit(0.75, 0.033),
+				swap(1., 0.034),
+				swap(2., 0.036),
+				swap(3., 0.037),
+				swap(5., 0.040),
+				swap(10., 0.043),
+				swap(30., 0.045),
+			};
+			constexpr size_t n = sizeof(is) / sizeof(*is);
+
+			curve<> f;
+			assert(bootstrap(f, n, is) == n);
+			assert(f.size() == n);
+			for (const auto& i : is) {
+				assert(fabs(bootstrap_error(f, i)) < 1e-14);
+			}
+			// same curve after enabling Eytzinger search
+			curve<> g;
+			g.search(true);
+			bootstrap(g, n, is);
+			for (double u : { 0.1, 1., 7., 30. }) {
+				assert(g.forward(u) == f.forward(u));
+			}
+		}
+		{
+			// no cash flow after the last knot
+			curve<> f;
+			f.extend(1., 0.03);
+			auto d = deposit(0.5, 0.03);
+			assert(_isnan(bootstrap(f, d.u.size(), d.u.data(), d.c.data(), d.p)));
+			assert(_isnan(bootstrap(f, d)));
+			assert(f.size() == 1);
+		}
+		{
+			// same maturity is rejected and the curve is unchanged
+			instrument<> is[] = {
+				deposit(1., 0.03),
+				swap(1., 0.031),
+				swap(2., 0.032),
+			};
+			curve<> f;
+			assert(bootstrap(f, 3, is) == 1);
+			assert(f.size() == 1);
+			assert(!_isnan(f.discount(1.)));
+			assert(fabs(bootstrap_error(f, is[0])) < 1e-14);
+		}
+
+		return 0;
+	}
+
+#endif // _DEBUG
+
+} // namespace fms::pwflat
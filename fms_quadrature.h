@@ -0,0 +1,129 @@
+// fms_quadrature.h - Numerical integration
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <utility>
+
+namespace fms::quadrature {
+
+	// Gauss-Kronrod 7-15 nodes and weights on [-1, 1] from QUADPACK
+	inline constexpr double xgk[] = {
+		0.991455371120812639206854697526329,
+		0.949107912342758524526189684047851,
+		0.864864423359769072789712788640926,
+		0.741531185599394439863864773280788,
+		0.586087235467691130294144845693013,
+		0.405845151377397166906606412076961,
+		0.207784955007898467600689403773245,
+		0.000000000000000000000000000000000
+	};
+	inline constexpr double wgk[] = {
+		0.022935322010529224963732008058970,
+		0.063092092629978553290700663189204,
+		0.104790010322250183839876322541518,
+		0.140653259715525918745189590510238,
+		0.169004726639267902826583426598550,
+		0.190350578064785409913256402421014,
+		0.204432940075298892414161999234649,
+		0.209482141084727828012999174891714
+	};
+	// Gauss weights for xgk[1], xgk[3], xgk[5], xgk[7]
+	inline constexpr double wg[] = {
+		0.129484966168869693270611432679082,
+		0.279705391489276667901467771423780,
+		0.381830050505118944950369775488975,
+		0.417959183673469387755102040816327
+	};
+
+	// Gauss-Kronrod 15 point estimate and error on [a, b]
+	template<class F>
+	inline std::pair<double, double> gauss_kronrod15(const F& f, double a, double b)
+	{
+		double c = (a + b) / 2;
+		double h = (b - a) / 2;
+
+		double fc = f(c);
+		double K = wgk[7] * fc;
+		double G = wg[3] * fc;
+		for (int i = 0; i < 7; ++i) {
+			double dx = h * xgk[i];
+			double fs = f(c - dx) + f(c + dx);
+			K += wgk[i] * fs;
+			if (i & 1) {
+				G += wg[i / 2] * fs;
+			}
+		}
+
+		return { K * h, fabs(K - G) * h };
+	}
+
+	// int_a^b f(x) dx using globally adaptive bisection of the subinterval with the
+	// largest Gauss-Kronrod error estimate until the total error is at most
+	// max(abs, rel |I|) or max_eval function evaluations are used.
+	// If err is not null it is set to the error estimate.
+	template<class F>
+	inline double gauss_kronrod(const F& f, double a, double b, double rel = 1e-12, double abs = 0,
+		unsigned max_eval = 15 * 100, double* err = nullptr)
+	{
+		struct interval {
+			double a, b, I, e;
+			bool operator<(const interval& i) const
+			{
+				return e < i.e;
+			}
+		};
+
+		auto [I, e] = gauss_kronrod15(f, a, b);
+		std::priority_queue<interval> q;
+		q.push(interval{ a, b, I, e });
+		for (unsigned n = 15; n + 30 <= max_eval && std::isfinite(I); n += 30) {
+			if (e <= std::max(abs, rel * fabs(I)) || e <= 64 * std::numeric_limits<double>::epsilon() * fabs(I)) {
+				break;
+			}
+
+			interval i = q.top();
+			q.pop();
+			double c = (i.a + i.b) / 2;
+			auto [I0, e0] = gauss_kronrod15(f, i.a, c);
+			auto [I1, e1] = gauss_kronrod15(f, c, i.b);
+			q.push(interval{ i.a, c, I0, e0 });
+			q.push(interval{ c, i.b, I1, e1 });
+			I += I0 + I1 - i.I;
+			e += e0 + e1 - i.e;
+		}
+		if (err) {
+			*err = e;
+		}
+
+		return I;
+	}
+
+	// int_{-infty}^b f(x) dx using x = b - l(1 - u)/u, 0 < u <= 1
+	template<class F>
+	inline double lower(const F& f, double b, double l = 1, double rel = 1e-12)
+	{
+		auto g = [&f, b, l](double u) {
+			double x = b - l * (1 - u) / u;
+
+			return std::isfinite(x) ? f(x) * l / (u * u) : 0;
+		};
+
+		return gauss_kronrod(g, 0., 1., rel);
+	}
+
+	// int_a^infty f(x) dx using x = a + l(1 - u)/u, 0 < u <= 1
+	template<class F>
+	inline double upper(const F& f, double a, double l = 1, double rel = 1e-12)
+	{
+		auto g = [&f, a, l](double u) {
+			double x = a + l * (1 - u) / u;
+
+			return std::isfinite(x) ? f(x) * l / (u * u) : 0;
+		};
+
+		return gauss_kronrod(g, 0., 1., rel);
+	}
+
+} // namespace fms::quadrature
@@ -0,0 +1,339 @@
+// fms_svi.h - SVI and SSVI implied volatility smiles
+// Raw SVI gives total implied variance w = sigma^2 t at log strike k = log(K/F) as
+//	w(k) = a + b (rho (k - m) + sqrt((k - m)^2 + sigma^2)).
+// SSVI gives a surface in terms of at-the-money total variance theta
+//	w(k, theta) = theta/2 (1 + rho phi k + sqrt((phi k + rho)^2 + 1 - rho^2))
+// with phi(theta) = eta/(theta^gamma (1 + theta)^(1 - gamma)).
+// Both are fitted by Levenberg-Marquardt with analytic Jacobians. Residuals
+// and Jacobian rows are computed in one branch free loop over strikes.
+// SSVI parameters are kept in the Gatheral-Jacquier no arbitrage region.
+// A previous fit is used as the starting point if it is valid.
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace fms::svi {
+
+	// Levenberg-Marquardt result
+	struct result {
+		unsigned iter;  // number of Jacobian evaluations
+		double rmse;    // root mean square residual
+		bool converged;
+	};
+
+	// Minimize |r(x)|^2 for n residuals and P parameters.
+	// f(x, r, J) sets r[i] and, if J is not null, J[i P + j] = dr[i]/dx[j].
+	// project(x) moves x into the domain after each step.
+	template<size_t P, class F, class Project>
+	inline result levenberg_marquardt(size_t n, F&& f, Project&& project, std::array<double, P>& x,
+		unsigned iter = 100, double tol = 1e-12)
+	{
+		std::vector<double> r(n), r_(n), J(n * P);
+		auto norm2 = [n](const std::vector<double>& y) {
+			double s = 0;
+			for (size_t i = 0; i < n; ++i) {
+				s += y[i] * y[i];
+			}
+			return s;
+		};
+
+		f(x, r.data(), J.data());
+		double cost = norm2(r);
+		double lambda = 1e-3;
+		unsigned k;
+		bool converged = false;
+
+		for (k = 1; k <= iter && !converged; ++k) {
+			// normal equations J'J and J'r
+			std::array<double, P * P> A{};
+			std::array<double, P> g{};
+			for (size_t i = 0; i < n; ++i) {
+				const double* Ji = J.data() + i * P;
+				for (size_t p = 0; p < P; ++p) {
+					g[p] += Ji[p] * r[i];
+					for (size_t q = 0; q <= p; ++q) {
+						A[p * P + q] += Ji[p] * Ji[q];
+					}
+				}
+			}
+
+			while (true) {
+				// Cholesky factor of J'J + lambda diag(J'J)
+				std::array<double, P * P> L{};
+				bool spd = true;
+				for (size_t p = 0; p < P && spd; ++p) {
+					for (size_t q = 0; q <= p; ++q) {
+						double s = A[p * P + q] * (p == q ? 1 + lambda : 1);
+						if (p == q) {
+							s += lambda * 1e-12; // keep singular directions solvable
+						}
+						for (size_t j = 0; j < q; ++j) {
+							s -= L[p * P + j] * L[q * P + j];
+						}
+						if (p == q) {
+							spd = s > 0;
+							L[p * P + p] = spd ? sqrt(s) : 0;
+						}
+						else {
+							L[p * P + q] = s / L[q * P + q];
+						}
+					}
+				}
+
+				if (spd) {
+					// solve L L' dx = -g
+					std::array<double, P> dx;
+					for (size_t p = 0; p < P; ++p) {
+						double s = -g[p];
+						for (size_t j = 0; j < p; ++j) {
+							s -= L[p * P + j] * dx[j];
+						}
+						dx[p] = s / L[p * P + p];
+					}
+					for (size_t p = P; p-- > 0; ) {
+						double s = dx[p];
+						for (size_t j = p + 1; j < P; ++j) {
+							s -= L[j * P + p] * dx[j];
+						}
+						dx[p] = s / L[p * P + p];
+					}
+
+					std::array<double, P> x_ = x;
+					double step = 0, size = 0;
+					for (size_t p = 0; p < P; ++p) {
+						x_[p] += dx[p];
+					}
+					project(x_);
+					for (size_t p = 0; p < P; ++p) {
+						step = std::max(step, fabs(x_[p] - x[p]));
+						size = std::max(size, fabs(x[p]));
+					}
+
+					f(x_, r_.data(), nullptr);
+					double cost_ = norm2(r_);
+					if (cost_ <= cost) {
+						converged = step <= sqrt(tol) * (size + sqrt(tol)) || cost - cost_ <= tol * cost;
+						x = x_;
+						r.swap(r_);
+						cost = cost_;
+						lambda = std::max(lambda / 10, 1e-12);
+						if (!converged) {
+							f(x, r.data(), J.data());
+						}
+
+						break;
+					}
+				}
+
+				lambda *= 10;
+				if (lambda > 1e12) {
+					converged = true; // no descent direction, x is a local minimum
+
+					break;
+				}
+			}
+		}
+
+		return result{ k - 1, n ? sqrt(cost / n) : 0, converged };
+	}
+
+	// raw SVI parameters
+	struct raw {
+		double a, b, rho, m, sigma;
+
+		// total implied variance at log strike k
+		double operator()(double k) const
+		{
+			double x = k - m;
+
+			return a + b * (rho * x + sqrt(x * x + sigma * sigma));
+		}
+		// dw/dk and d^2w/dk^2
+		double d1(double k) const
+		{
+			double x = k - m;
+
+			return b * (rho + x / sqrt(x * x + sigma * sigma));
+		}
+		double d2(double k) const
+		{
+			double x = k - m;
+			double R = sqrt(x * x + sigma * sigma);
+
+			return b * sigma * sigma / (R * R * R);
+		}
+
+		// b >= 0, |rho| < 1, sigma > 0, and w >= 0
+		bool valid() const
+		{
+			return b >= 0 && fabs(rho) < 1 && sigma > 0 && a + b * sigma * sqrt(1 - rho * rho) >= 0;
+		}
+
+		// Durrleman's condition g(k) >= 0 means the implied density is nonnegative at k
+		double butterfly(double k) const
+		{
+			double w = operator()(k), w1 = d1(k), w2 = d2(k);
+			double u = 1 - k * w1 / (2 * w);
+
+			return u * u - w1 * w1 / 4 * (1 / w + 0.25) + w2 / 2;
+		}
+		// smallest value of butterfly on n equally spaced points of [k0, k1]
+		double butterfly(double k0, double k1, size_t n = 201) const
+		{
+			double g = std::numeric_limits<double>::infinity();
+			for (size_t i = 0; i < n; ++i) {
+				g = std::min(g, butterfly(k0 + (k1 - k0) * i / (n - 1)));
+			}
+
+			return g;
+		}
+
+		// residuals w(k[i]) - w[i] and Jacobian rows d/d(a, b, rho, m, sigma)
+		void residuals(size_t n, const double* k, const double* w, double* r, double* J = nullptr) const
+		{
+			if (!J) {
+				for (size_t i = 0; i < n; ++i) {
+					double x = k[i] - m;
+					r[i] = a + b * (rho * x + sqrt(x * x + sigma * sigma)) - w[i];
+				}
+
+				return;
+			}
+
+			for (size_t i = 0; i < n; ++i) {
+				double x = k[i] - m;
+				double R = sqrt(x * x + sigma * sigma);
+				r[i] = a + b * (rho * x + R) - w[i];
+				double* Ji = J + 5 * i;
+				Ji[0] = 1;
+				Ji[1] = rho * x + R;
+				Ji[2] = b * x;
+				Ji[3] = -b * (rho + x / R);
+				Ji[4] = b * sigma / R;
+			}
+		}
+	};
+
+	// Fit raw SVI to total variances w[i] at log strikes k[i].
+	// If p is valid it is the starting point, otherwise a default guess is used.
+	inline result fit(size_t n, const double* k, const double* w, raw& p, unsigned iter = 100)
+	{
+		if (n < 5) {
+			return result{ 0, std::numeric_limits<double>::quiet_NaN(), false };
+		}
+
+		if (!p.valid()) {
+			size_t i = std::min_element(w, w + n) - w;
+			auto [k0, k1] = std::minmax_element(k, k + n);
+			p = raw{ w[i] / 2, 0.1, -0.3, k[i], std::max(0.1 * (*k1 - *k0), 1e-2) };
+		}
+
+		std::array<double, 5> x = { p.a, p.b, p.rho, p.m, p.sigma };
+		auto f = [n, k, w](const std::array<double, 5>& x, double* r, double* J) {
+			raw{ x[0], x[1], x[2], x[3], x[4] }.residuals(n, k, w, r, J);
+		};
+		auto project = [](std::array<double, 5>& x) {
+			x[1] = std::max(x[1], 0.);
+			x[2] = std::clamp(x[2], -0.999, 0.999);
+			x[4] = std::max(x[4], 1e-6);
+			// nonnegative minimum variance
+			x[0] = std::max(x[0], -x[1] * x[4] * sqrt(1 - x[2] * x[2]));
+		};
+		result res = levenberg_marquardt<5>(n, f, project, x, iter);
+		p = raw{ x[0], x[1], x[2], x[3], x[4] };
+
+		return res;
+	}
+
+	// SSVI with power law phi
+	struct ssvi {
+		double rho, eta, gamma;
+
+		double phi(double theta) const
+		{
+			return eta / (pow(theta, gamma) * pow(1 + theta, 1 - gamma));
+		}
+		// total implied variance at log strike k for at-the-money total variance theta
+		double operator()(double k, double theta) const
+		{
+			double u = phi(theta) * k;
+
+			return theta / 2 * (1 + rho * u + sqrt((u + rho) * (u + rho) + 1 - rho * rho));
+		}
+
+		// Sufficient for no static arbitrage (Gatheral-Jacquier) when theta is increasing in t.
+		bool arbitrage_free() const
+		{
+			return fabs(rho) < 1 && eta > 0 && 0 < gamma && gamma <= 0.5 && eta * (1 + fabs(rho)) <= 2;
+		}
+
+		// residuals w(k[i], theta[i]) - w[i] and Jacobian rows d/d(rho, eta, gamma)
+		void residuals(size_t n, const double* k, const double* theta, const double* w, double* r, double* J = nullptr) const
+		{
+			if (!J) {
+				for (size_t i = 0; i < n; ++i) {
+					r[i] = operator()(k[i], theta[i]) - w[i];
+				}
+
+				return;
+			}
+
+			for (size_t i = 0; i < n; ++i) {
+				double u = phi(theta[i]) * k[i];
+				double Q = sqrt((u + rho) * (u + rho) + 1 - rho * rho);
+				r[i] = theta[i] / 2 * (1 + rho * u + Q) - w[i];
+				double wu = theta[i] / 2 * (rho + (u + rho) / Q); // dw/du
+				double* Ji = J + 3 * i;
+				Ji[0] = theta[i] / 2 * (u + u / Q);
+				Ji[1] = wu * u / eta;
+				Ji[2] = wu * u * log((1 + theta[i]) / theta[i]);
+			}
+		}
+	};
+
+	// Fit SSVI to total variances w[i] at log strikes k[i] having at-the-money total variance theta[i].
+	// If p is arbitrage free it is the starting point. Steps are projected onto
+	// |rho| < 1, 0 < gamma <= 1/2, and 0 < eta <= 2/(1 + |rho|) so the fit is arbitrage free.
+	inline result fit(size_t n, const double* k, const double* theta, const double* w, ssvi& p, unsigned iter = 100)
+	{
+		if (n < 3) {
+			return result{ 0, std::numeric_limits<double>::quiet_NaN(), false };
+		}
+
+		if (!p.arbitrage_free()) {
+			p = ssvi{ -0.3, 0.5, 0.5 };
+		}
+
+		std::array<double, 3> x = { p.rho, p.eta, p.gamma };
+		auto f = [n, k, theta, w](const std::array<double, 3>& x, double* r, double* J) {
+			ssvi{ x[0], x[1], x[2] }.residuals(n, k, theta, w, r, J);
+		};
+		auto project = [](std::array<double, 3>& x) {
+			x[0] = std::clamp(x[0], -0.999, 0.999);
+			x[1] = std::clamp(x[1], 1e-6, (2 - 1e-12) / (1 + fabs(x[0]))); // inside after roundoff
+			x[2] = std::clamp(x[2], 1e-6, 0.5);
+		};
+		result res = levenberg_marquardt<3>(n, f, project, x, iter);
+		p = ssvi{ x[0], x[1], x[2] };
+
+		return res;
+	}
+
+	// Smallest w1(k) - w0(k) on n equally spaced points of [k0, k1].
+	// Negative values are calendar arbitrage between raw fits at expirations t0 < t1.
+	inline double calendar(const raw& w0, const raw& w1, double k0, double k1, size_t n = 201)
+	{
+		double d = std::numeric_limits<double>::infinity();
+		for (size_t i = 0; i < n; ++i) {
+			double k = k0 + (k1 - k0) * i / (n - 1);
+			d = std::min(d, w1(k) - w0(k));
+		}
+
+		return d;
+	}
+
+} // namespace fms::svi
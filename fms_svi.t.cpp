@@ -0,0 +1,118 @@
+// fms_svi.t.cpp - Test SVI and SSVI smiles
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include <random>
+#include <vector>
+#include "fms_svi.h"
+
+using namespace fms;
+
+int svi_raw_test()
+{
+	svi::raw p0{ 0.04, 0.4, -0.4, 0.05, 0.2 };
+	assert(p0.valid());
+
+	size_t n = 50;
+	std::vector<double> k(n), w(n);
+	for (size_t i = 0; i < n; ++i) {
+		k[i] = -1 + 2. * i / (n - 1);
+		w[i] = p0(k[i]);
+	}
+
+	{
+		// analytic Jacobian
+		std::vector<double> r(n), J(5 * n), r_(n);
+		p0.residuals(n, k.data(), w.data(), r.data(), J.data());
+		double h = 1e-6;
+		double svi::raw::* x[] = { &svi::raw::a, &svi::raw::b, &svi::raw::rho, &svi::raw::m, &svi::raw::sigma };
+		for (size_t j = 0; j < 5; ++j) {
+			svi::raw p = p0;
+			p.*x[j] += h;
+			p.residuals(n, k.data(), w.data(), r_.data());
+			for (size_t i = 0; i < n; ++i) {
+				assert(fabs((r_[i] - r[i]) / h - J[5 * i + j]) < 1e-5);
+			}
+		}
+	}
+	{
+		// recover parameters from the default guess
+		svi::raw p{ 0, 0, 0, 0, 0 };
+		svi::result res = svi::fit(n, k.data(), w.data(), p);
+		assert(res.converged);
+		assert(res.rmse < 1e-12);
+		assert(fabs(p.a - p0.a) < 1e-8 && fabs(p.b - p0.b) < 1e-8 && fabs(p.rho - p0.rho) < 1e-8);
+		assert(fabs(p.m - p0.m) < 1e-8 && fabs(p.sigma - p0.sigma) < 1e-8);
+
+		// warm start from the previous fit after a small move
+		std::vector<double> w_(n);
+		for (size_t i = 0; i < n; ++i) {
+			w_[i] = w[i] * 1.01 + 0.001 * k[i];
+		}
+		svi::raw q{ 0, 0, 0, 0, 0 };
+		svi::result cold = svi::fit(n, k.data(), w_.data(), q);
+		svi::result warm = svi::fit(n, k.data(), w_.data(), p);
+		assert(warm.iter < cold.iter);
+		assert(fabs(warm.rmse - cold.rmse) < 1e-8);
+	}
+	{
+		// arbitrage checks
+		assert(p0.butterfly(-1.5, 1.5) > 0);
+		// Gatheral-Jacquier example with negative density
+		svi::raw bad{ -0.0410, 0.1331, 0.3060, 0.3586, 0.4153 };
+		assert(bad.butterfly(-1.5, 1.5) < 0);
+		svi::raw p1 = p0;
+		p1.a += 0.01;
+		assert(svi::calendar(p0, p1, -1, 1) > 0);
+		assert(svi::calendar(p1, p0, -1, 1) < 0);
+	}
+
+	return 0;
+}
+int svi_raw_test_ = svi_raw_test();
+
+int svi_ssvi_test()
+{
+	svi::ssvi s0{ -0.5, 1.0, 0.4 };
+	assert(s0.arbitrage_free());
+
+	std::vector<double> k, theta, w;
+	for (double t : { 0.01, 0.02, 0.04, 0.08, 0.16 }) {
+		for (size_t i = 0; i <= 20; ++i) {
+			k.push_back(-0.5 + i * 0.05);
+			theta.push_back(t);
+			w.push_back(s0(k.back(), t));
+		}
+	}
+	// at-the-money total variance is theta
+	assert(fabs(s0(0, 0.04) - 0.04) < 1e-15);
+
+	svi::ssvi s{ 0, 0, 0 };
+	svi::result res = svi::fit(k.size(), k.data(), theta.data(), w.data(), s);
+	assert(res.converged);
+	assert(res.rmse < 1e-12);
+	assert(fabs(s.rho - s0.rho) < 1e-8 && fabs(s.eta - s0.eta) < 1e-8 && fabs(s.gamma - s0.gamma) < 1e-8);
+
+	// warm start at the solution
+	res = svi::fit(k.size(), k.data(), theta.data(), w.data(), s);
+	assert(res.converged && res.iter <= 2);
+	assert(fabs(s.rho - s0.rho) < 1e-8 && fabs(s.eta - s0.eta) < 1e-8 && fabs(s.gamma - s0.gamma) < 1e-8);
+
+	// data with gamma > 1/2 is fitted in the no arbitrage region
+	svi::ssvi s1{ -0.5, 1.5, 0.7 };
+	assert(!s1.arbitrage_free());
+	for (size_t i = 0; i < w.size(); ++i) {
+		w[i] = s1(k[i], theta[i]);
+	}
+	s = svi::ssvi{ 0, 0, 0 };
+	res = svi::fit(k.size(), k.data(), theta.data(), w.data(), s);
+	assert(s.arbitrage_free());
+	// and is used as the next starting point
+	res = svi::fit(k.size(), k.data(), theta.data(), w.data(), s);
+	assert(res.converged && res.iter <= 2);
+
+	return 0;
+}
+int svi_ssvi_test_ = svi_ssvi_test();
+
+#endif // _DEBUG
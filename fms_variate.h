@@ -1,5 +1,8 @@
 // fms_variate.h - NVI base class for all variate bases
 #pragma once
+#include <cmath>
+#include <cstddef>
+#include <limits>
 
 namespace fms::variate {
 
@@ -12,15 +15,88 @@ namespace fms::variate {
 		{
 			return _cdf(x, s, nx, ns);
 		}
+		// p[i] = cdf(x[i], s, nx, ns), 0 <= i < n
+		void cdf(size_t n, const double* x, double* p, double s = 0, unsigned nx = 0, unsigned ns = 0) const
+		{
+			_cdf_batch(n, x, p, s, nx, ns);
+		}
 		// kappa(s) = log E[exp(s X)] 
 		double cumulant(double s, unsigned n = 0) const
 		{
 			return _cumulant(s, n);
 		}
+		// x with P^s(X <= x) = p, 0 < p < 1
+		double quantile(double p, double s = 0) const
+		{
+			return _quantile(p, s);
+		}
 	private:
 		// overridden in derived class
 		virtual double _cdf(double x, double s, unsigned nx, unsigned ns) const = 0;
 		virtual double _cumulant(double s, unsigned n) const = 0;
+		// default is pointwise evaluation
+		virtual void _cdf_batch(size_t n, const double* x, double* p, double s, unsigned nx, unsigned ns) const
+		{
+			for (size_t i = 0; i < n; ++i) {
+				p[i] = _cdf(x[i], s, nx, ns);
+			}
+		}
+		// default is root finding on cdf
+		virtual double _quantile(double p, double s) const
+		{
+			if (!(0 < p && p < 1)) {
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+
+			// bracket the root
+			double lo = -1, hi = 1;
+			while (cdf(lo, s) > p) {
+				hi = lo;
+				lo *= 2;
+				if (!std::isfinite(lo)) {
+					return lo;
+				}
+			}
+			while (cdf(hi, s) < p) {
+				lo = hi;
+				hi *= 2;
+				if (!std::isfinite(hi)) {
+					return hi;
+				}
+			}
+
+			// Newton-Raphson safeguarded by bisection
+			double x = (lo + hi) / 2;
+			for (unsigned n = 0; n < 100; ++n) {
+				double px = cdf(x, s) - p;
+				if (px == 0) {
+					break;
+				}
+				(px < 0 ? lo : hi) = x;
+
+				double dx = px / cdf(x, s, 1);
+				double x_ = x - dx;
+				if (!(lo < x_ && x_ < hi)) {
+					x_ = (lo + hi) / 2;
+				}
+				if (fabs(x_ - x) <= std::numeric_limits<double>::epsilon() * (1 + fabs(x))) {
+					return x_;
+				}
+				x = x_;
+			}
+
+			return x;
+		}
 	};
 
+	// Free function versions for generic code. See fms_dual.h.
+	inline double cdf(const base& v, double x, double s = 0, unsigned nx = 0, unsigned ns = 0)
+	{
+		return v.cdf(x, s, nx, ns);
+	}
+	inline double cumulant(const base& v, double s, unsigned n = 0)
+	{
+		return v.cumulant(s, n);
+	}
+
 } // namespace fms
\ No newline at end of file
@@ -0,0 +1,184 @@
+// fms_variate_density.h - Normal variance-mean mixtures closed under the Esscher transform
+// X = mu + b V + sqrt(V) Z where V >= 0 is independent of the standard normal Z.
+// The Esscher transform by s has the same form with drift b + s and mixing density
+// proportional to e^{(b s + s^2/2) v} f_V(v), so
+//   P^s(X <= x) = E^s[Phi((x - mu - (b + s) V)/sqrt(V))].
+// The expectation is the trapezoidal rule in log V. The integrand is analytic in a
+// strip about the real axis so the error decreases geometrically in the step size.
+// The nodes are fixed for a variate and s so a cdf costs one erfc per node.
+// The smaller tail is summed and nodes with |z| beyond the range of Phi are skipped.
+// Derivatives of order nx + ns <= 2 with respect to x and s use nested dual numbers.
+//
+// The derived class V must provide
+//   double location() const; // mu
+//   template<class S> S drift(const S& s) const; // b + s
+//   template<class S, class G> void nodes(const S& s, G&& g) const;
+// where nodes calls g(v, sqrt(v), w) for nodes of the transformed mixing variable in
+// decreasing order of v with weights summing to 1, and stops when g returns false.
+// The derived class implements _cumulant.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "fms_dual.h"
+#include "fms_variate.h"
+
+namespace fms::variate {
+
+	inline constexpr double pi = 3.14159265358979323846;
+
+	// log K_nu(z), z > 0, using the asymptotic expansion for large z to avoid underflow
+	inline double log_bessel_k(double nu, double z)
+	{
+		if (z > 500) {
+			double m = 4 * nu * nu;
+			double t = 1 + (m - 1) / (8 * z) + (m - 1) * (m - 9) / (128 * z * z);
+
+			return log(pi / (2 * z)) / 2 - z + log(t);
+		}
+
+		return log(std::cyl_bessel_k(fabs(nu), z));
+	}
+
+	// K_{nu - 1}(z)/K_nu(z)
+	inline double bessel_k_ratio(double nu, double z)
+	{
+		return exp(log_bessel_k(nu - 1, z) - log_bessel_k(nu, z));
+	}
+
+	template<class V>
+	struct density : public base {
+	private:
+		const V& derived() const
+		{
+			return static_cast<const V&>(*this);
+		}
+	protected:
+		// value of a possibly nested dual
+		template<class T>
+		static double primal(const T& x)
+		{
+			if constexpr (std::is_same_v<T, double>) {
+				return x;
+			}
+			else {
+				return primal(x.x);
+			}
+		}
+	private:
+		// nested dual with derivative 1 at the levels set in m, outermost first
+		template<class T>
+		static T seed(double x, unsigned m)
+		{
+			if constexpr (std::is_same_v<T, double>) {
+				return x;
+			}
+			else {
+				using X = decltype(T{}.x);
+
+				return T(seed<X>(x, m >> 1), X(m & 1));
+			}
+		}
+		// derivative with respect to every level
+		template<class T>
+		static double top(const T& x)
+		{
+			if constexpr (std::is_same_v<T, double>) {
+				return x;
+			}
+			else {
+				return top(x.dx);
+			}
+		}
+		// P^s(X <= x) given nodes(s, g)
+		template<class T, class N>
+		T P(const T& x, const T& s, N&& nodes) const
+		{
+			constexpr double sqrt2 = 1.41421356237309504880;
+			T y = x - derived().location();
+			T d = derived().drift(s);
+			// sum 1 - P if x is above the location
+			bool upper = primal(y) > 0;
+			T b = upper ? -d : d;
+			T ay = fabs(y);
+			T p(0);
+
+			nodes(s, [&](const T& v, const T& sv, const T& w) {
+				T z = (y - d * v) / sv;
+				if (upper) {
+					z = -z;
+				}
+				// Phi(z) = 0 and z decreases with v
+				if (z < -38 && ay / v + b > 0) {
+					return false;
+				}
+				p += w * erfc(-z / sqrt2) / 2;
+
+				return true;
+			});
+
+			return upper ? 1 - p : p;
+		}
+	public:
+		// P^s(X <= x) for T double or dual
+		template<class T>
+		T P(const T& x, const T& s) const
+		{
+			return P(x, s, [this](const T& s, auto&& g) { derived().nodes(s, g); });
+		}
+
+		double _cdf(double x, double s, unsigned nx = 0, unsigned ns = 0) const override
+		{
+			// one nested dual level for each derivative
+			unsigned mx = (1u << nx) - 1;
+			unsigned ms = ((1u << ns) - 1) << nx;
+			auto D = [this, x, s, mx, ms](auto t) {
+				using T = decltype(t);
+
+				return top(P<T>(seed<T>(x, mx), seed<T>(s, ms)));
+			};
+
+			switch (nx + ns) {
+			case 0:
+				return P(x, s);
+			case 1:
+				return D(dual<>{});
+			case 2:
+				return D(dual<dual<>>{});
+			}
+
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+
+		// Nodes are computed once for all points.
+		void _cdf_batch(size_t n, const double* x, double* p, double s, unsigned nx, unsigned ns) const override
+		{
+			if (nx != 0 || ns != 0) {
+				for (size_t j = 0; j < n; ++j) {
+					p[j] = _cdf(x[j], s, nx, ns);
+				}
+
+				return;
+			}
+
+			std::vector<double> v, sv, w;
+			derived().nodes(s, [&](double vi, double svi, double wi) {
+				v.push_back(vi);
+				sv.push_back(svi);
+				w.push_back(wi);
+
+				return true;
+			});
+			auto stored = [&v, &sv, &w](double, auto&& g) {
+				for (size_t i = 0; i < v.size() && g(v[i], sv[i], w[i]); ++i)
+					;
+			};
+			for (size_t j = 0; j < n; ++j) {
+				p[j] = P(x[j], s, stored);
+			}
+		}
+	};
+
+} // namespace fms::variate
@@ -0,0 +1,153 @@
+// fms_variate_density.t.cpp - Test NIG, variance gamma, and Student t variates
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include "fms_option.h"
+#include "fms_quadrature.h"
+#include "fms_variate_nig.h"
+#include "fms_variate_student.h"
+#include "fms_variate_variance_gamma.h"
+
+using namespace fms;
+using namespace fms::variate;
+
+// compare cdf and cumulant derivatives with symmetric difference quotients
+inline bool variate_derivative_test(const base& v, double x, double s, double tol = 1e-8)
+{
+	double h = 1e-5;
+	bool b = true;
+
+	// d/dx and d/ds
+	b = b && fabs((v.cdf(x + h, s) - v.cdf(x - h, s)) / (2 * h) - v.cdf(x, s, 1)) < tol;
+	b = b && fabs((v.cdf(x, s + h) - v.cdf(x, s - h)) / (2 * h) - v.cdf(x, s, 0, 1)) < tol;
+	b = b && fabs((v.cdf(x, s + h, 0, 1) - v.cdf(x, s - h, 0, 1)) / (2 * h) - v.cdf(x, s, 0, 2)) < tol;
+	b = b && fabs((v.cdf(x + h, s, 1) - v.cdf(x - h, s, 1)) / (2 * h) - v.cdf(x, s, 2)) < tol;
+	// kappa' and kappa''
+	b = b && fabs((v.cumulant(s + h) - v.cumulant(s - h)) / (2 * h) - v.cumulant(s, 1)) < tol;
+	b = b && fabs((v.cumulant(s + h, 1) - v.cumulant(s - h, 1)) / (2 * h) - v.cumulant(s, 2)) < tol;
+
+	return b;
+}
+
+inline bool variate_batch_test(const base& v, double s)
+{
+	double x[] = { 1, -1, 0, 2, -3, 2 };
+	double p[6];
+	v.cdf(6, x, p, s);
+	for (int i = 0; i < 6; ++i) {
+		if (fabs(p[i] - v.cdf(x[i], s)) > 1e-12) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+int variate_density_test()
+{
+	nig N(2, 0.5);
+	variance_gamma V(0.5, -0.3);
+	const base* vs[] = { &N, &V };
+
+	// standardized
+	for (const base* v : vs) {
+		assert(fabs(v->cumulant(0, 1)) < 1e-15);
+		assert(fabs(v->cumulant(0, 2) - 1) < 1e-15);
+	}
+	for (const base* v : vs) {
+		for (double s : { 0., 0.1, 0.3 }) {
+			assert(fabs(v->cdf(100, s) - 1) < 1e-12);
+			assert(fabs(v->cdf(-100, s)) < 1e-12);
+			for (double x : { -2., -0.5, 0.01, 1.5 }) {
+				assert(variate_derivative_test(*v, x, s));
+			}
+			assert(variate_batch_test(*v, s));
+		}
+	}
+	{
+		// d/dx P^s(X <= x) is the closed form density of the Esscher transform
+		// and the cdf agrees with integrating it
+		for (double s : { 0., 0.3 }) {
+			nig Ns = N.esscher(s);
+			variance_gamma Vs = V.esscher(s);
+			for (double x : { -2., -0.5, 0.01, 1.5 }) {
+				assert(fabs(N.cdf(x, s, 1) - Ns.pdf(x)) < 1e-13);
+				assert(fabs(V.cdf(x, s, 1) - Vs.pdf(x)) < 1e-13);
+				double p = quadrature::lower([&Ns](double y) { return Ns.pdf(y); }, x);
+				assert(fabs(N.cdf(x, s) - p) < 1e-12);
+			}
+		}
+	}
+	{
+		// put-call parity
+		double f = 100, s = 0.2, k = 105;
+		for (const base* v : vs) {
+			double c = option::black::value(*v, f, s, k);
+			double p = option::black::value(*v, f, s, -k);
+			assert(fabs(c - p - (f - k)) < 1e-10);
+		}
+	}
+	{
+		// singular density at mu when nu >= 2
+		variance_gamma V3(3, -0.3);
+		for (double x : { -1., 0., 0.3, 1. }) {
+			double p;
+			V3.cdf(1, &x, &p, 0.1);
+			assert(fabs(p - V3.cdf(x, 0.1)) < 1e-10);
+		}
+	}
+
+	return 0;
+}
+int variate_density_test_ = variate_density_test();
+
+int quadrature_test()
+{
+	// relative tolerance
+	double e;
+	double I = quadrature::gauss_kronrod([](double x) { return 1e6 * exp(x); }, 0., 1., 1e-12, 0., 1500, &e);
+	assert(fabs(I - 1e6 * (exp(1.) - 1)) <= 1e-12 * I);
+	assert(e <= 1e-12 * I);
+	// evaluation budget for a singular integrand
+	unsigned n = 0;
+	I = quadrature::gauss_kronrod([&n](double x) { ++n; return 1 / sqrt(x); }, 0., 1., 1e-15, 0., 150, &e);
+	assert(n <= 150);
+	assert(fabs(I - 2) <= e);
+
+	return 0;
+}
+int quadrature_test_ = quadrature_test();
+
+int variate_student_test()
+{
+	double xs[] = { -2, -0.3, 0, 0.3, 5 };
+	{
+		// Cauchy
+		student C(1, 0, 1);
+		for (double x : xs) {
+			assert(fabs(C.cdf(x) - (0.5 + atan(x) / pi)) < 1e-15);
+		}
+	}
+	{
+		student T(2, 0, 1);
+		for (double x : xs) {
+			assert(fabs(T.cdf(x) - (0.5 + x / (2 * sqrt(2 + x * x)))) < 1e-15);
+		}
+	}
+	{
+		student T(5);
+		assert(fabs(T.cumulant(0, 2) - 1) < 1e-15);
+		assert(std::isinf(T.cumulant(0.1)));
+		assert(std::isnan(T.cdf(0, 0.1)));
+		for (double x : xs) {
+			double h = 1e-5;
+			assert(fabs((T.cdf(x + h) - T.cdf(x - h)) / (2 * h) - T.cdf(x, 0, 1)) < 1e-9);
+			assert(fabs((T.cdf(x + h, 0, 1) - T.cdf(x - h, 0, 1)) / (2 * h) - T.cdf(x, 0, 2)) < 1e-9);
+		}
+	}
+
+	return 0;
+}
+int variate_student_test_ = variate_student_test();
+
+#endif // _DEBUG
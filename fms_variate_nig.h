@@ -0,0 +1,129 @@
+// fms_variate_nig.h - Normal inverse Gaussian variate
+// The density is
+//   f(x) = alpha delta K_1(alpha q(x))/(pi q(x)) e^{delta gamma + beta (x - mu)}
+// where q(x) = sqrt(delta^2 + (x - mu)^2), gamma = sqrt(alpha^2 - beta^2),
+// alpha > |beta|, and delta > 0.
+//
+// kappa(s) = mu s + delta(gamma - sqrt(alpha^2 - (beta + s)^2)), |beta + s| < alpha.
+// The Esscher transform of NIG(alpha, beta, delta, mu) is NIG(alpha, beta + s, delta, mu).
+//
+// As a mixture V is inverse Gaussian with mean delta/gamma and shape delta^2, and drift b = beta.
+// W = V gamma/delta is inverse Gaussian with mean 1 and shape phi = delta gamma so
+// u = log W has density sqrt(phi/(2 pi)) e^{-u/2 - phi(cosh(u) - 1)}.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "fms_variate_density.h"
+
+namespace fms::variate {
+
+	struct nig : public density<nig> {
+		double alpha, beta, delta, mu;
+		double gamma, logc; // logc = log(alpha delta/pi) + delta gamma
+
+		nig(double alpha, double beta, double delta, double mu)
+			: alpha(alpha), beta(beta), delta(delta), mu(mu),
+			  gamma(sqrt(alpha * alpha - beta * beta)), logc(log(alpha * delta / pi) + delta * gamma)
+		{ }
+		// mean 0 and variance 1
+		// mean = mu + delta beta/gamma, variance = delta alpha^2/gamma^3
+		nig(double alpha, double beta)
+			: nig(alpha, beta,
+				pow(alpha * alpha - beta * beta, 1.5) / (alpha * alpha),
+				-beta * (alpha * alpha - beta * beta) / (alpha * alpha))
+		{ }
+
+		nig esscher(double s) const
+		{
+			return nig(alpha, beta + s, delta, mu);
+		}
+
+		double location() const
+		{
+			return mu;
+		}
+		template<class S>
+		S drift(const S& s) const
+		{
+			return beta + s;
+		}
+		// trapezoidal rule in u = log W for the transformed variate
+		// until the density is e^{-40} times the mode
+		template<class S, class G>
+		void nodes(const S& s, G&& g) const
+		{
+			S b = beta + s;
+			S g2 = alpha * alpha - b * b;
+			if (!(g2 > 0)) {
+				S nan(std::numeric_limits<double>::quiet_NaN());
+				g(nan, nan, nan);
+
+				return;
+			}
+
+			S gs = sqrt(g2);
+			S phi = delta * gs;
+			S m = delta / gs; // mean of V
+			S sm = sqrt(m);
+			double ph = primal(phi);
+			double h = std::min(0.2, 0.5 / sqrt(ph));
+			double u_hi = acosh(1 + 40 / ph);
+			double u_lo = -acosh(1 + (41 + u_hi) / ph);
+			S c = h * sqrt(phi / (2 * pi));
+
+			double eh = exp(-h / 2);
+			double e = exp(u_hi / 2); // e^{u/2}
+			for (double u = u_hi; u >= u_lo; u -= h, e *= eh) {
+				double W = e * e;
+				if (!g(m * W, sm * e, c * exp(-u / 2 - phi * ((W + 1 / W) / 2 - 1)))) {
+					break;
+				}
+			}
+		}
+
+		// density and its derivative
+		double pdf(double x, unsigned n = 0) const
+		{
+			double y = x - mu;
+			double q = hypot(delta, y);
+			double z = alpha * q;
+			double f = exp(logc + beta * y - log(q) + log_bessel_k(1, z));
+
+			if (n == 0) {
+				return f;
+			}
+
+			// K_1'(z) = -K_0(z) - K_1(z)/z
+			return f * (beta - 2 * y / (q * q) - alpha * (y / q) * bessel_k_ratio(1, z));
+		}
+
+		// kappa(s) and derivatives
+		double _cumulant(double s, unsigned n = 0) const override
+		{
+			double b = beta + s;
+			if (fabs(b) >= alpha) {
+				return n == 0 ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+			}
+
+			double a2 = alpha * alpha;
+			double r = sqrt(a2 - b * b);
+
+			switch (n) {
+			case 0:
+				return mu * s + delta * (gamma - r);
+			case 1:
+				return mu + delta * b / r;
+			case 2:
+				return delta * a2 / (r * r * r);
+			case 3:
+				return 3 * delta * a2 * b / pow(r, 5);
+			case 4:
+				return 3 * delta * a2 * (a2 + 4 * b * b) / pow(r, 7);
+			}
+
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+	};
+
+} // namespace fms::variate
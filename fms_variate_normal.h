@@ -1,6 +1,7 @@
 // fms_variate_normal.h - Normally distributed random variate
 #pragma once
 #include <cmath>
+#include <limits>
 #include "fms_variate.h"
 
 namespace fms::variate {
@@ -46,6 +47,70 @@ namespace fms::variate {
 			return phi * H(n - 1, x) * ((n & 1) ? 1 : -1);
 		}
 
+		// Inverse of N using Acklam's rational approximation and one Halley step.
+		// https://web.archive.org/web/20151030215612/http://home.online.no/~pjacklam/notes/invnorm/
+		static double N_inv(double p)
+		{
+			static constexpr double a[] = {
+				-3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+				1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00
+			};
+			static constexpr double b[] = {
+				-5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+				6.680131188771972e+01, -1.328068155288572e+01
+			};
+			static constexpr double c[] = {
+				-7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+				-2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00
+			};
+			static constexpr double d[] = {
+				7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+				3.754408661907416e+00
+			};
+			constexpr double p_low = 0.02425;
+
+			if (!(0 < p && p < 1)) {
+				if (p == 0) {
+					return -std::numeric_limits<double>::infinity();
+				}
+				if (p == 1) {
+					return std::numeric_limits<double>::infinity();
+				}
+
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+
+			double x;
+			if (p < p_low || p > 1 - p_low) {
+				double q = sqrt(-2 * log(p < p_low ? p : 1 - p));
+				x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5])
+					/ ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+				if (p > p_low) {
+					x = -x;
+				}
+			}
+			else {
+				double q = p - 0.5;
+				double r = q * q;
+				x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) * q
+					/ (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+			}
+
+			// Halley step using erfc to keep precision in the left tail
+			double e = erfc(-x / M_SQRT2) / 2 - p;
+			double u = e * M_SQRT2PI * exp(x * x / 2);
+			x = x - u / (1 + x * u / 2);
+
+			return x;
+		}
+		// x[i] = N_inv(p[i]), 0 <= i < n
+		static void N_inv(size_t n, const double* p, double* x)
+		{
+			for (size_t i = 0; i < n; ++i) {
+				x[i] = N_inv(p[i]);
+			}
+		}
+
 		// P^s(X <= x) = P(X <= x - s) and derivatives
 		double _cdf(double x, double s, unsigned nx = 0, unsigned ns = 0) const override
 		{
@@ -67,6 +132,12 @@ namespace fms::variate {
 
 			return 0;
 		}
+
+		// P^s(X <= x) = p iff x = N_inv(p) + s
+		double _quantile(double p, double s) const override
+		{
+			return N_inv(p) + s;
+		}
 	};
 
 } // namespace fms::variate
@@ -4,6 +4,7 @@
 #include <cassert>
 #include <algorithm>
 #include "fms_variate_normal.h"
+#include "fms_variate_quantile.h"
 #include "fms_derivative.h"
 
 using namespace fms;
@@ -102,4 +103,30 @@ int normal_cdf_test()
 }
 int normal_cdf_test_ = normal_cdf_test();
 
+int normal_quantile_test()
+{
+	{
+		assert(0 == normal::N_inv(0.5));
+		for (double p : { 1e-10, 1e-4, 0.01, 0.02425, 0.1, 0.3, 0.7, 0.9, 0.99, 1 - 1e-4}) {
+			double x = normal::N_inv(p);
+			assert(fabs(erfc(-x / M_SQRT2) / 2 - p) <= 8 * p * epsilon);
+		}
+	}
+	{
+		normal N;
+		double s = 0.2;
+		quantile_table Q(N, 1024, s);
+		for (double p = 1e-6; p < 1; p += 0.0123) {
+			double x = N.quantile(p, s);
+			assert(x == normal::N_inv(p) + s);
+			if (0.01 <= p && p <= 0.99) {
+				assert(fabs(Q(p) - x) <= 1e-6);
+			}
+		}
+	}
+
+	return 0;
+}
+int normal_quantile_test_ = normal_quantile_test();
+
 #endif // _DEBUG
\ No newline at end of file
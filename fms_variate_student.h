@@ -0,0 +1,152 @@
+// fms_variate_student.h - Student t variate
+// X = mu + sigma T where T has density
+//   Gamma((nu + 1)/2)/(sqrt(nu pi) Gamma(nu/2)) (1 + t^2/nu)^{-(nu + 1)/2}.
+// P(T <= t) = I_z(nu/2, 1/2)/2 for t < 0 and 1 - I_z(nu/2, 1/2)/2 for t >= 0
+// where z = nu/(nu + t^2) and I is the regularized incomplete beta function.
+//
+// The moment generating function does not exist so kappa(s) is infinite for s != 0
+// and the Esscher transform is only defined for s = 0. Use it for sampling and
+// cdf evaluation, not in option pricing.
+#pragma once
+#include <cmath>
+#include <limits>
+#include "fms_variate.h"
+
+namespace fms::variate {
+
+	struct student : public base {
+		double nu, mu, sigma;
+		double logB, logc; // log B(nu/2, 1/2) and log of density normalization
+
+		student(double nu, double mu, double sigma)
+			: nu(nu), mu(mu), sigma(sigma),
+			  logB(lgamma(nu / 2) + lgamma(0.5) - lgamma(nu / 2 + 0.5)),
+			  logc(-logB - log(nu) / 2 - log(sigma))
+		{ }
+		// variance 1, nu > 2
+		student(double nu)
+			: student(nu, 0, sqrt((nu - 2) / nu))
+		{ }
+
+		// continued fraction for I_x(a, b) using modified Lentz
+		static double betacf(double a, double b, double x)
+		{
+			constexpr double eps = std::numeric_limits<double>::epsilon();
+			constexpr double tiny = std::numeric_limits<double>::min() / eps;
+
+			double qab = a + b, qap = a + 1, qam = a - 1;
+			double c = 1, d = 1 - qab * x / qap;
+			if (fabs(d) < tiny) {
+				d = tiny;
+			}
+			d = 1 / d;
+			double h = d;
+			for (int m = 1; m <= 300; ++m) {
+				int m2 = 2 * m;
+				double aa = m * (b - m) * x / ((qam + m2) * (a + m2));
+				d = 1 + aa * d;
+				if (fabs(d) < tiny) {
+					d = tiny;
+				}
+				c = 1 + aa / c;
+				if (fabs(c) < tiny) {
+					c = tiny;
+				}
+				d = 1 / d;
+				h *= d * c;
+
+				aa = -(a + m) * (qab + m) * x / ((a + m2) * (qap + m2));
+				d = 1 + aa * d;
+				if (fabs(d) < tiny) {
+					d = tiny;
+				}
+				c = 1 + aa / c;
+				if (fabs(c) < tiny) {
+					c = tiny;
+				}
+				d = 1 / d;
+				double del = d * c;
+				h *= del;
+				if (fabs(del - 1) <= eps) {
+					break;
+				}
+			}
+
+			return h;
+		}
+
+		// regularized incomplete beta I_x(a, b) given y = 1 - x and log B(a, b)
+		static double ibeta(double a, double b, double x, double y, double logB)
+		{
+			if (x <= 0) {
+				return 0;
+			}
+			if (y <= 0) {
+				return 1;
+			}
+
+			double bt = exp(a * log(x) + b * log(y) - logB);
+
+			return x < (a + 1) / (a + b + 2)
+				? bt * betacf(a, b, x) / a
+				: 1 - bt * betacf(b, a, y) / b;
+		}
+
+		// P(X <= x) and derivatives with respect to x for s = 0
+		double _cdf(double x, double s, unsigned nx = 0, unsigned ns = 0) const override
+		{
+			if (s != 0 || ns != 0) {
+				return std::numeric_limits<double>::quiet_NaN();
+			}
+
+			double t = (x - mu) / sigma;
+			double t2 = t * t;
+
+			if (nx == 0) {
+				if (std::isinf(t)) {
+					return t < 0 ? 0 : 1;
+				}
+				// compute 1 - z directly to keep precision near t = 0
+				double I = ibeta(nu / 2, 0.5, nu / (nu + t2), t2 / (nu + t2), logB);
+
+				return t < 0 ? I / 2 : 1 - I / 2;
+			}
+
+			double f = exp(logc - (nu + 1) / 2 * log1p(t2 / nu));
+			if (nx == 1) {
+				return f;
+			}
+			if (nx == 2) {
+				return -f * (nu + 1) * t / ((nu + t2) * sigma);
+			}
+
+			return std::numeric_limits<double>::quiet_NaN();
+		}
+
+		// kappa(0) = 0 and cumulants when they exist
+		double _cumulant(double s, unsigned n = 0) const override
+		{
+			constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+			if (s != 0) {
+				return n == 0 ? std::numeric_limits<double>::infinity() : NaN;
+			}
+
+			switch (n) {
+			case 0:
+				return 0;
+			case 1:
+				return nu > 1 ? mu : NaN;
+			case 2:
+				return nu > 2 ? sigma * sigma * nu / (nu - 2) : std::numeric_limits<double>::infinity();
+			case 3:
+				return nu > 3 ? 0 : NaN;
+			case 4:
+				return nu > 4 ? 6 * pow(sigma, 4) * nu * nu / ((nu - 2) * (nu - 2) * (nu - 4)) : NaN;
+			}
+
+			return NaN;
+		}
+	};
+
+} // namespace fms::variate
@@ -10,6 +10,7 @@
 #pragma once
 #include <algorithm>
 #include <limits>
+#include "fms_dual.h"
 #include "fms_variate.h"
 
 namespace fms::variate {
@@ -19,10 +20,13 @@ namespace fms::variate {
 		double l, m, h;
 		double a, b;
 		
-		static double I(double x, double s) {
+		// S is double or dual to differentiate with respect to s
+		template<class S>
+		static S I(double x, S s) {
 			return exp(s * x) / s;
 		};
-		static double Ix(double x, double s) {
+		template<class S>
+		static S Ix(double x, S s) {
 			return exp(s * x) * (x / s - 1 / (s * s));
 		};
 
@@ -32,6 +36,37 @@ namespace fms::variate {
 			// ensure(l < m)
 			// ensure(m < h);
 		}
+		// E[e^{s X} 1(X <= x)]
+		template<class S>
+		S Ps(double x, S s) const
+		{
+			if (s == 0) {
+				if (x <= l) {
+					return S(0);
+				}
+				if (x <= m) {
+					return S(a * (x - l) * (x - l) / 2);
+				}
+				if (x <= h) {
+					return S(1 - b * (h - x) * (h - x) / 2);
+				}
+
+				return S(1);
+			}
+
+			S Ps_ = 0;
+			if (l <= x) {
+				double xm = std::min(x, m);
+				Ps_ = (a * Ix(xm, s) - a * l * I(xm, s)) - (a * Ix(l, s) - a * l * I(l, s));
+				if (m < x) {
+					double xh = std::min(x, h);
+					Ps_ += (b * h * I(xh, s) - b * Ix(xh, s)) - (b * h * I(m, s) - b * Ix(m, s));
+				}
+			}
+
+			return Ps_;
+		}
+
 		// P^s(X <= x) = E[e^{s X - kappa(s)} 1(X <= x)] and derivatives
 		// cdf(x, s, nx, ns) = int_{-infty^x} e^{s y - kappa(y)} f(y) dy.
 		double _cdf(double x, double s, unsigned nx = 0, unsigned ns = 0) const override
@@ -39,18 +74,18 @@ namespace fms::variate {
 			double mgfs = mgf(s); // e^{kappa(s)}
 
 			if (nx == 0 && ns == 0) {
-				double Ps = 0;
-				if (l <= x) {
-					double xm = std::min(x, m);
-					Ps = (a * Ix(xm, s) - a * l * I(xm, s)) - (a * Ix(l, s) - a * l * I(l, s));
-					if (m <= x && x <= h) {
-						Ps += (b * h * I(x, s) - b * Ix(x, s)) - (b * h * I(m, s) - b * Ix(m, s));
-					}
+				return Ps(x, s) / mgfs;
+			}
+			if (nx == 0 && ns == 1) {
+				if (s == 0) {
+					return std::numeric_limits<double>::quiet_NaN();
 				}
 
-				return Ps / mgfs;
+				dual<> s_(s, 1);
+
+				return (Ps(x, s_) / mgf(s_)).dx;
 			}
-			if (nx == 1 && ns == 0) {
+			if (nx == 1 && ns <= 1) {
 				double ps = 0;
 				if (l <= x && x <= m) {
 					ps = a * (x - l);
@@ -60,13 +95,10 @@ namespace fms::variate {
 				}
 				ps *= exp(s * x) / mgfs;
 
-				return ps;
+				// d/ds e^{s x - kappa(s)} = (x - kappa'(s)) e^{s x - kappa(s)}
+				return ns == 0 ? ps : ps * (x - _cumulant(s, 1));
 			}
 
-			//!!! implement for nx = 0, ns = 0
-			//!!! implement for nx = 1, ns = 0
-			//!!! implement for nx = 1, ns = 1
-
 			return std::numeric_limits<double>::quiet_NaN();
 		}
 
@@ -82,25 +114,39 @@ namespace fms::variate {
 		//   [a e^{sx}(x/s - 1/s^2) - al e^{sx}/s]_l^m
 		// + [bh e^{sx}/s - b e^{sx}(x/s - 1/s^2)]_m^h
 		//
-		double mgf(double s) const
+		template<class S>
+		S mgf(S s) const
 		{
 			if (s == 0) {
-				return 1;
+				return S(1);
 			}
 
 
-			double Esx = (a * Ix(m, s) - a * l * I(m, s)) - (a * Ix(l, s) - a * l * I(l, s));
+			S Esx = (a * Ix(m, s) - a * l * I(m, s)) - (a * Ix(l, s) - a * l * I(l, s));
 			Esx += (b * h * I(h, s) - b * Ix(h, s)) - (b * h * I(m, s) - b * Ix(m, s));
 
 			return Esx;
 		}
+		// derivatives using dual numbers for s != 0
 		double _cumulant(double s, unsigned n = 0) const override
 		{
-			if (n != 0) {
-				return std::numeric_limits<double>::quiet_NaN();
+			if (n == 0) {
+				return log(mgf(s));
+			}
+			if (n == 1) {
+				return s == 0 ? (l + m + h) / 3 : log(mgf(dual<>(s, 1))).dx;
 			}
+			if (n == 2) {
+				if (s == 0) {
+					return (l * l + m * m + h * h - l * m - l * h - m * h) / 18;
+				}
+
+				dual<dual<>> s_(dual<>(s, 1), dual<>(1));
 
-			return log(mgf(s));
+				return log(mgf(s_)).dx.dx;
+			}
+
+			return std::numeric_limits<double>::quiet_NaN();
 		}
 	};
 
@@ -0,0 +1,63 @@
+// fms_variate_triangular.t.cpp - Test triangular variate
+#ifdef _DEBUG
+// Only test in debug mode
+#include <cassert>
+#include "fms_derivative.h"
+#include "fms_dual.h"
+#include "fms_option.h"
+#include "fms_variate_quantile.h"
+#include "fms_variate_triangular.h"
+
+using namespace fms;
+using namespace fms::variate;
+
+int triangular_quantile_test()
+{
+	{
+		// base default root finding
+		triangular T(-1, 0, 2);
+		double s = 0.1;
+		quantile_table Q(T, 256, s);
+		for (double p = 0.001; p < 1; p += 0.0123) {
+			double x = T.quantile(p, s);
+			assert(fabs(T.cdf(x, s) - p) <= 100 * epsilon);
+			assert(fabs(Q(p) - x) <= 1e-4);
+		}
+		// cdf is 1 beyond the support for any s
+		for (double s_ : { 0., 0.1, -0.3 }) {
+			assert(T.cdf(-1.5, s_) == 0);
+			assert(fabs(T.cdf(2.5, s_) - 1) <= 10 * epsilon);
+		}
+		assert(T.quantile(1 - 1e-12, s) <= 2);
+	}
+
+	return 0;
+}
+int triangular_quantile_test_ = triangular_quantile_test();
+
+int triangular_dual_test()
+{
+	{
+		// triangular vega has no closed form
+		triangular T(-1, 0, 2);
+		double s = 0.2, h = 1e-5;
+		for (double x : { -0.5, 0.5, 1.5 }) {
+			double dP = (T.cdf(x, s + h) - T.cdf(x, s - h)) / (2 * h);
+			assert(fabs(T.cdf(x, s, 0, 1) - dP) < 1e-9);
+			double dp = (T.cdf(x, s + h, 1) - T.cdf(x, s - h, 1)) / (2 * h);
+			assert(fabs(T.cdf(x, s, 1, 1) - dp) < 1e-9);
+		}
+		assert(fabs(T.cumulant(s, 1) - (T.cumulant(s + h) - T.cumulant(s - h)) / (2 * h)) < 1e-9);
+		assert(fabs(T.cumulant(s, 2) - (T.cumulant(s + h, 1) - T.cumulant(s - h, 1)) / (2 * h)) < 1e-8);
+		for (double k : { -1.2, -0.8, 0.8, 1.2 }) {
+			auto v = option::black::value<dual<>>(T, 1., dual<>(s, 1), k);
+			double dv = (option::black::value(T, 1., s + h, k) - option::black::value(T, 1., s - h, k)) / (2 * h);
+			assert(fabs(v.dx - dv) < 1e-8);
+		}
+	}
+
+	return 0;
+}
+int triangular_dual_test_ = triangular_dual_test();
+
+#endif // _DEBUG
@@ -0,0 +1,148 @@
+// fms_variate_variance_gamma.h - Variance gamma variate
+// X = mu + theta G + sigma sqrt(G) Z where G is gamma with mean 1 and variance nu
+// and Z is standard normal independent of G. The density is
+//   f(x) = c e^{theta y/sigma^2} (|y|/sqrt(A))^lambda K_lambda(|y| sqrt(A)/sigma^2)
+// where y = x - mu, A = 2 sigma^2/nu + theta^2, lambda = 1/nu - 1/2, and
+// c = 2/(nu^{1/nu} sqrt(2 pi) sigma Gamma(1/nu)).
+//
+// kappa(s) = mu s - log(l(s))/nu, l(s) = 1 - theta nu s - sigma^2 nu s^2/2.
+// The Esscher transform is VG(sigma/sqrt(l), nu, (theta + sigma^2 s)/l, mu), l = l(s).
+//
+// As a mixture V = sigma^2 G has drift b = theta/sigma^2 and under the Esscher
+// transform G is gamma with shape 1/nu and scale nu/l(s). Nodes of the standard
+// gamma in log coordinates are computed once and scaled for each s.
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "fms_variate_density.h"
+
+namespace fms::variate {
+
+	struct variance_gamma : public density<variance_gamma> {
+		double sigma, nu, theta, mu;
+		double lambda, sqrtA, logc;
+		double r1, r2; // roots of l(s), r1 < 0 < r2
+		std::vector<double> E, sE, w; // standard gamma nodes in decreasing order, square roots, and weights
+
+		variance_gamma(double sigma, double nu, double theta, double mu)
+			: sigma(sigma), nu(nu), theta(theta), mu(mu),
+			  lambda(1 / nu - 0.5), sqrtA(sqrt(2 * sigma * sigma / nu + theta * theta)),
+			  logc(log(2.) - log(nu) / nu - log(sqrt(2 * pi) * sigma) - lgamma(1 / nu)),
+			  r1((-theta - sqrtA) / (sigma * sigma)), r2((-theta + sqrtA) / (sigma * sigma))
+		{
+			// trapezoidal rule in u = log E for the density e^{a u - e^u}/Gamma(a)
+			// from the mode until it is e^{-40} smaller
+			double a = 1 / nu;
+			double h = std::min(0.2, 0.5 / sqrt(a));
+			double u0 = log(a);
+			auto g = [a, u0](double u) { return a * (u - u0) - exp(u) + a; };
+			double u = u0;
+			while (g(u + h) > -40) {
+				u += h;
+			}
+			double W = 0;
+			for (; g(u) > -40; u -= h) {
+				E.push_back(exp(u));
+				sE.push_back(exp(u / 2));
+				w.push_back(exp(g(u)));
+				W += w.back();
+			}
+			for (double& wi : w) {
+				wi /= W;
+			}
+		}
+		// mean 0 and variance 1, theta^2 nu < 1
+		// mean = mu + theta, variance = sigma^2 + theta^2 nu
+		variance_gamma(double nu, double theta)
+			: variance_gamma(sqrt(1 - theta * theta * nu), nu, theta, -theta)
+		{ }
+
+		template<class S>
+		S l(const S& s) const
+		{
+			return 1 - theta * nu * s - sigma * sigma * nu * s * s / 2;
+		}
+
+		variance_gamma esscher(double s) const
+		{
+			double ls = l(s);
+
+			return variance_gamma(sigma / sqrt(ls), nu, (theta + sigma * sigma * s) / ls, mu);
+		}
+
+		double location() const
+		{
+			return mu;
+		}
+		template<class S>
+		S drift(const S& s) const
+		{
+			return theta / (sigma * sigma) + s;
+		}
+		// V = sigma^2 nu/l(s) E
+		template<class S, class G>
+		void nodes(const S& s, G&& g) const
+		{
+			S ls = l(s);
+			if (!(ls > 0)) {
+				S nan(std::numeric_limits<double>::quiet_NaN());
+				g(nan, nan, nan);
+
+				return;
+			}
+
+			S c = sigma * sigma * nu / ls;
+			S sc = sqrt(c);
+			for (size_t i = 0; i < E.size() && g(c * E[i], sc * sE[i], S(w[i])); ++i)
+				;
+		}
+
+		// density and its derivative
+		double pdf(double x, unsigned n = 0) const
+		{
+			double y = x - mu;
+			double s2 = sigma * sigma;
+
+			if (y == 0) {
+				if (n > 0 || lambda <= 0) {
+					return n > 0 ? std::numeric_limits<double>::quiet_NaN() : std::numeric_limits<double>::infinity();
+				}
+
+				// K_lambda(z) ~ Gamma(lambda)/2 (2/z)^lambda as z -> 0
+				return exp(logc + lgamma(lambda) - log(2.) + lambda * log(2 * s2 / (sqrtA * sqrtA)));
+			}
+
+			double z = fabs(y) * sqrtA / s2;
+			double f = exp(logc + theta * y / s2 + lambda * log(fabs(y) / sqrtA) + log_bessel_k(lambda, z));
+
+			if (n == 0) {
+				return f;
+			}
+
+			// K_lambda'(z) = -K_{lambda - 1}(z) - (lambda/z) K_lambda(z)
+			return f * (theta / s2 - (y > 0 ? 1 : -1) * (sqrtA / s2) * bessel_k_ratio(lambda, z));
+		}
+
+		// kappa(s) and derivatives
+		// l(s) = (sigma^2 nu/2)(s - r1)(r2 - s)
+		double _cumulant(double s, unsigned n = 0) const override
+		{
+			if (!(r1 < s && s < r2)) {
+				return n == 0 ? std::numeric_limits<double>::infinity() : std::numeric_limits<double>::quiet_NaN();
+			}
+			if (n == 0) {
+				return mu * s - log(l(s)) / nu;
+			}
+
+			// d^n/ds^n log(s - r1) = (-1)^{n-1} (n-1)!/(s - r1)^n
+			// d^n/ds^n log(r2 - s) = -(n-1)!/(r2 - s)^n
+			double n1 = tgamma(n);
+			double dn = n1 * ((n & 1 ? 1 : -1) / pow(s - r1, n) - 1 / pow(r2 - s, n));
+
+			return (n == 1 ? mu : 0) - dn / nu;
+		}
+	};
+
+} // namespace fms::variate
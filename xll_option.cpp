@@ -1,5 +1,15 @@
 // xll_option.cpp - Black-Scholes/Merton option value and greeks.
+#include "fms_chebyshev.h"
 #include "fms_option.h"
+#include "fms_option_asian.h"
+#include "fms_option_barrier.h"
+#include "fms_option_implied.h"
+#include "fms_option_portfolio.h"
+#include "fms_option_rates.h"
+#include "fms_option_term.h"
+#include "fms_option_var.h"
+#include "fms_pde.h"
+#include "fms_svi.h"
 #include "fms_binomial.h"
 #include "fms_variate_normal.h"
 #include "xll_FRE6233.h"
@@ -63,6 +73,86 @@ XLL_CONST(WORD, OPTION_CALL, contract::CALL, "European call option", CATEGORY, O
 XLL_CONST(WORD, OPTION_DIGITAL_PUT, contract::DIGITAL_PUT, "European digital put option", CATEGORY, OPTION_URL);
 XLL_CONST(WORD, OPTION_DIGITAL_CALL, contract::DIGITAL_CALL, "European digital call option", CATEGORY, OPTION_URL);
 
+#define BARRIER_URL "https://en.wikipedia.org/wiki/Barrier_option"
+
+XLL_CONST(WORD, OPTION_BARRIER_DOWN_IN, barrier::DOWN_IN, "Knock in when the spot falls to the barrier", CATEGORY, BARRIER_URL);
+XLL_CONST(WORD, OPTION_BARRIER_DOWN_OUT, barrier::DOWN_OUT, "Knock out when the spot falls to the barrier", CATEGORY, BARRIER_URL);
+XLL_CONST(WORD, OPTION_BARRIER_UP_IN, barrier::UP_IN, "Knock in when the spot rises to the barrier", CATEGORY, BARRIER_URL);
+XLL_CONST(WORD, OPTION_BARRIER_UP_OUT, barrier::UP_OUT, "Knock out when the spot rises to the barrier", CATEGORY, BARRIER_URL);
+
+AddIn xai_option_barrier(
+	Function(XLL_DOUBLE, "xll_option_barrier", "OPTION.BARRIER")
+	.Arguments({
+		Arg(XLL_DOUBLE, "S", "is the spot."),
+		Arg(XLL_DOUBLE, "sigma", "is the volatility."),
+		Arg(XLL_WORD, "option", "is the contract type from OPTION_*."),
+		Arg(XLL_DOUBLE, "k", "is the strike."),
+		Arg(XLL_DOUBLE, "t", "is the time in years to expiration."),
+		Arg(XLL_WORD, "barrier", "is the barrier type from OPTION_BARRIER_*."),
+		Arg(XLL_DOUBLE, "h", "is the barrier level."),
+		Arg(XLL_DOUBLE, "_r", "is the optional continuously compouned interest rate. Default is 0."),
+		Arg(XLL_DOUBLE, "_rebate", "is the optional rebate paid at expiration. Default is 0."),
+		})
+	.FunctionHelp("Return the value of a continuously monitored single barrier option.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Closed form value for the normal variate using the reflection principle.
+The rebate is paid at expiration if an out option knocks out or
+an in option never knocks in.
+)")
+);
+double WINAPI xll_option_barrier(double S, double sigma, contract c, double k, double t, barrier b, double h, double r, double R)
+{
+#pragma XLLEXPORT
+	double result = XLL_NAN;
+
+	try {
+		result = bsm::barrier_value(r, S, sigma, c, k, t, b, h, R);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return result;
+}
+
+AddIn xai_option_asian(
+	Function(XLL_DOUBLE, "xll_option_asian", "OPTION.ASIAN")
+	.Arguments({
+		Arg(XLL_DOUBLE, "S", "is the spot."),
+		Arg(XLL_DOUBLE, "sigma", "is the volatility."),
+		Arg(XLL_WORD, "option", "is the contract type OPTION_PUT or OPTION_CALL."),
+		Arg(XLL_DOUBLE, "k", "is the strike."),
+		Arg(XLL_DOUBLE, "t", "is the time in years to expiration."),
+		Arg(XLL_WORD, "n", "is the number of equally spaced fixings."),
+		Arg(XLL_DOUBLE, "_r", "is the optional continuously compouned interest rate. Default is 0."),
+		Arg(XLL_BOOL, "_geometric", "is an optional boolean indicating a geometric average. Default is FALSE."),
+		})
+	.FunctionHelp("Return the value of an option on the average of the spot at n fixings.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+The average of \(S_{t_i}\), \(t_i = it/n\), \(1\le i\le n\), for the normal variate.
+Geometric averages are lognormal and have a closed form value.
+Arithmetic averages use the lognormal having the same first two moments.
+)")
+);
+double WINAPI xll_option_asian(double S, double sigma, contract c, double k, double t, unsigned n, double r, BOOL geometric)
+{
+#pragma XLLEXPORT
+	double result = XLL_NAN;
+
+	try {
+		result = geometric
+			? bsm::asian_geometric(r, S, sigma, c, k, t, n)
+			: bsm::asian_arithmetic(r, S, sigma, c, k, t, n);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return result;
+}
+
 AddIn xai_option_value(
 	Function(XLL_DOUBLE, "xll_option_value", "OPTION.VALUE")
 	.Arguments({
@@ -222,25 +312,23 @@ AddIn xai_option_theta(
 		Arg(XLL_DOUBLE, "k", "is the strike."),
 		Arg(XLL_DOUBLE, "t", "is the time in years to expiration"),
 		Arg(XLL_DOUBLE, "r", "is the continuously compouned interest rate. Default is 0."),
-		Arg(XLL_DOUBLE, "_dt", "is an optional time increment. Default is 1/250."),
 		})
 	.FunctionHelp("Return the option call (k > 0) or put (k < 0) theta.")
 	.Category(CATEGORY)
 	.Documentation(R"(
-Option theta is the derivative of option value with respect to time.
+Option theta is the negative of the derivative of option value with respect to time
+to expiration. It is computed in closed form from the rate, delta, and vega terms
+\(-\partial v/\partial t = r v - D(r f\,\partial b/\partial f + \partial b/\partial s\,\sigma/(2\sqrt{t}))\)
+where \(v = D b(f, s)\), \(D = e^{-rt}\), \(f = S/D\), and \(s = \sigma\sqrt{t}\).
 )")
 );
-double WINAPI xll_option_theta(HANDLEX v, double S, double sigma, int flag, double k, double t, double r, double dt)
+double WINAPI xll_option_theta(HANDLEX v, double S, double sigma, int flag, double k, double t, double r)
 {
 #pragma XLLEXPORT
 	double result = XLL_NAN;
 
 	try {
-		if (dt == 0) {
-			dt = 1. / 250;
-		}
-
-	    result = bsm::theta(*pv(v), r, S, sigma, flag, k, t, dt);
+		result = bsm::theta(*pv(v), r, S, sigma, flag, k, t);
 	}
 	catch (const std::exception& ex) {
 		XLL_ERROR(ex.what());
@@ -260,14 +348,19 @@ AddIn xai_option_implied(
 		Arg(XLL_DOUBLE, "v", "is the option value."),
 		Arg(XLL_DOUBLE, "k", "is the strike."),
 		Arg(XLL_DOUBLE, "t", "is the time in years to expiration."),
-		Arg(XLL_DOUBLE, "_sigma", "is an optional initial guess. Default is 0.1."),
+		Arg(XLL_DOUBLE, "_sigma", "is an optional initial guess. Default is the Corrado-Miller approximation."),
 		Arg(XLL_WORD, "_n", "is an optional maximum number of iterations. Default is 100."),
-		Arg(XLL_DOUBLE, "_tol", "is an optional absolute tolerance. Default is square root of machine epsilon."),
+		Arg(XLL_DOUBLE, "_tol", "is an optional absolute tolerance. Default is machine precision."),
 		})
 	.FunctionHelp("Return the option call (k > 0) or put (k < 0) implied vol.")
 	.Category(CATEGORY)
 	.Documentation(R"(
 Option implied volatility is the inverse of value.
+The value is converted to the out-of-the-money option using put-call parity
+and the log of its value is solved using Halley's method safeguarded by bisection.
+Return <code>#NUM!</code> if the value is not strictly between
+the intrinsic value and the forward for calls or the strike for puts,
+or if the iteration does not converge.
 )")
 );
 double WINAPI xll_option_implied(HANDLEX v, double f, double v0, double k, double t, double sigma, unsigned n, double tol)
@@ -276,7 +369,9 @@ double WINAPI xll_option_implied(HANDLEX v, double f, double v0, double k, doubl
 	double result = XLL_NAN;
 
 	try {
-	    result = black::implied(*pv(v), f, v0, k, sigma * sqrt(t), n, tol);
+		ensure(t > 0);
+		double srt = sqrt(t);
+		result = black::implied(*pv(v), f, v0, k, sigma * srt, n, tol * srt) / srt;
 	}
 	catch (const std::exception& ex) {
 		XLL_ERROR(ex.what());
@@ -288,6 +383,743 @@ double WINAPI xll_option_implied(HANDLEX v, double f, double v0, double k, doubl
 	return result;
 }
 
+AddIn xai_option_implied_chain(
+	Function(XLL_FP, "xll_option_implied_chain", "OPTION.IMPLIED.CHAIN")
+	.Arguments({
+		Arg(XLL_HANDLEX, "v", "is a handle to a variate."),
+		Arg(XLL_FP, "f", "is a forward or array of forwards."),
+		Arg(XLL_FP, "v", "is an array of option values."),
+		Arg(XLL_FP, "k", "is an array of strikes."),
+		Arg(XLL_FP, "t", "is a time in years to expiration or array of times."),
+		Arg(XLL_BOOL, "_status", "is an optional boolean indicating status codes should be returned. Default is FALSE."),
+		})
+	.FunctionHelp("Return the implied vol of every option in a chain.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Invert each value using <code>OPTION.IMPLIED</code> on all available threads.
+Forwards and times can be a single value shared by all quotes or
+arrays the same size as the values.
+The result has the same shape as <code>v</code>. Quotes that can not be inverted
+are <code>#NUM!</code>. If <code>_status</code> is true return the status of each quote instead:
+0 converged, 1 invalid input, 2 value at or below intrinsic,
+3 value at or above the maximum, 4 did not converge.
+)")
+);
+_FPX* WINAPI xll_option_implied_chain(HANDLEX v, const _FPX* pf, const _FPX* pv0, const _FPX* pk, const _FPX* pt, BOOL status)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		size_t n = size(*pv0);
+		ensure(size(*pk) == n);
+		ensure(size(*pf) == 1 || size(*pf) == n);
+		ensure(size(*pt) == 1 || size(*pt) == n);
+		for (size_t i = 0; i < size(*pt); ++i) {
+			ensure(pt->array[i] > 0);
+		}
+
+		std::vector<double> f(n), s(n, 0.);
+		std::vector<implied_status> st(n);
+		for (size_t i = 0; i < n; ++i) {
+			f[i] = pf->array[size(*pf) == 1 ? 0 : i];
+		}
+		black::implied(*pv(v), n, f.data(), pv0->array, pk->array, s.data(), st.data());
+
+		result.resize(pv0->rows, pv0->columns);
+		for (size_t i = 0; i < n; ++i) {
+			double t = pt->array[size(*pt) == 1 ? 0 : i];
+			result[i] = status ? st[i] : s[i] / sqrt(t);
+		}
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_implied_stream_(
+	Function(XLL_HANDLEX, "xll_option_implied_stream_", "\\OPTION.IMPLIED.STREAM")
+	.Arguments({
+		Arg(XLL_HANDLEX, "v", "is a handle to a variate."),
+		Arg(XLL_WORD, "_n", "is an optional maximum number of iterations. Default is 100."),
+		})
+	.Uncalced()
+	.FunctionHelp("Return a handle to implied vols that are updated as quotes change.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+The handle remembers the last value, implied vol, and vega of each instrument id.
+Use <code>OPTION.IMPLIED.STREAM.UPDATE</code> to solve only the quotes that changed.
+)")
+);
+HANDLEX WINAPI xll_option_implied_stream_(HANDLEX v, unsigned n)
+{
+#pragma XLLEXPORT
+	HANDLEX h = INVALID_HANDLEX;
+
+	try {
+		handle<black::implied_stream<double>> h_(new black::implied_stream<double>(*pv(v), n));
+		ensure(h_);
+
+		h = h_.get();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return h;
+}
+
+AddIn xai_option_implied_stream_update(
+	Function(XLL_FP, "xll_option_implied_stream_update", "OPTION.IMPLIED.STREAM.UPDATE")
+	.Arguments({
+		Arg(XLL_HANDLEX, "h", "is a handle returned by \\OPTION.IMPLIED.STREAM."),
+		Arg(XLL_FP, "id", "is an array of instrument ids."),
+		Arg(XLL_FP, "f", "is a forward or array of forwards."),
+		Arg(XLL_FP, "v", "is an array of option values."),
+		Arg(XLL_FP, "k", "is an array of strikes."),
+		Arg(XLL_FP, "t", "is a time in years to expiration or array of times."),
+		})
+	.FunctionHelp("Return implied vols solving only quotes that changed since the last update.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Quotes with the same forward, value, and strike as the last update of their id
+are not solved again. Changed quotes start from the previous implied vol
+corrected by the change in value divided by vega.
+)")
+);
+_FPX* WINAPI xll_option_implied_stream_update(HANDLEX h, const _FPX* pid, const _FPX* pf, const _FPX* pv0, const _FPX* pk, const _FPX* pt)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		handle<black::implied_stream<double>> h_(h);
+		ensure(h_);
+		size_t n = size(*pv0);
+		ensure(size(*pid) == n);
+		ensure(size(*pk) == n);
+		ensure(size(*pf) == 1 || size(*pf) == n);
+		ensure(size(*pt) == 1 || size(*pt) == n);
+		for (size_t i = 0; i < size(*pt); ++i) {
+			ensure(pt->array[i] > 0);
+		}
+
+		result.resize(pv0->rows, pv0->columns);
+		for (size_t i = 0; i < n; ++i) {
+			double f = pf->array[size(*pf) == 1 ? 0 : i];
+			double t = pt->array[size(*pt) == 1 ? 0 : i];
+			result[i] = h_->update(pid->array[i], f, pv0->array[i], pk->array[i]) / sqrt(t);
+		}
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_portfolio_(
+	Function(XLL_HANDLEX, "xll_option_portfolio_", "\\OPTION.PORTFOLIO")
+	.Arguments({
+		Arg(XLL_FP, "u", "is an array of underlying indices starting at 0."),
+		Arg(XLL_FP, "option", "is an array of contract types from OPTION_*."),
+		Arg(XLL_FP, "k", "is an array of strikes."),
+		Arg(XLL_FP, "t", "is an array of times in years to expiration."),
+		Arg(XLL_FP, "sigma", "is an array of volatilities."),
+		Arg(XLL_FP, "q", "is an array of quantities."),
+		Arg(XLL_HANDLEX, "_v", "is an optional handle to a variate. Default is normal."),
+		})
+	.Uncalced()
+	.FunctionHelp("Return a handle to a portfolio of option positions.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Positions are stored by column and sorted by underlying, expiration, contract,
+and volatility so positions sharing an expiration are priced together.
+Use <code>OPTION.PORTFOLIO.RISK</code> to compute aggregate value and greeks.
+)")
+);
+HANDLEX WINAPI xll_option_portfolio_(const _FPX* pu, const _FPX* pc, const _FPX* pk, const _FPX* pt, const _FPX* ps, const _FPX* pq, HANDLEX v)
+{
+#pragma XLLEXPORT
+	HANDLEX h = INVALID_HANDLEX;
+
+	try {
+		size_t n = size(*pu);
+		ensure(size(*pc) == n);
+		ensure(size(*pk) == n);
+		ensure(size(*pt) == n);
+		ensure(size(*ps) == n);
+		ensure(size(*pq) == n);
+
+		handle<bsm::portfolio> h_(new bsm::portfolio());
+		ensure(h_);
+		const variate::base& v_ = *pv(v);
+		for (size_t i = 0; i < n; ++i) {
+			ensure(pu->array[i] >= 0);
+			h_->add(static_cast<size_t>(pu->array[i]), v_, static_cast<int>(pc->array[i]),
+				pk->array[i], pt->array[i], ps->array[i], pq->array[i]);
+		}
+		h_->sort();
+
+		h = h_.get();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return h;
+}
+
+AddIn xai_option_portfolio_risk(
+	Function(XLL_FP, "xll_option_portfolio_risk", "OPTION.PORTFOLIO.RISK")
+	.Arguments({
+		Arg(XLL_HANDLEX, "h", "is a handle returned by \\OPTION.PORTFOLIO."),
+		Arg(XLL_FP, "S", "is an array of spots for each underlying."),
+		Arg(XLL_FP, "r", "is a rate or array of rates for each underlying."),
+		})
+	.FunctionHelp("Return value, delta, gamma, vega, and theta of each underlying in a portfolio.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Return one row per underlying with the quantity weighted sum of
+value, delta, gamma, vega, and theta of its positions.
+Positions are priced on all available threads and summed in a fixed order
+so the result does not depend on the number of threads.
+)")
+);
+_FPX* WINAPI xll_option_portfolio_risk(HANDLEX h, const _FPX* pS, const _FPX* pr)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		handle<bsm::portfolio> h_(h);
+		ensure(h_);
+		size_t n = h_->underlyings();
+		ensure(size(*pS) == n);
+		ensure(size(*pr) == 1 || size(*pr) == n);
+
+		std::vector<double> r(n, pr->array[0]);
+		if (size(*pr) == n) {
+			std::copy(pr->array, pr->array + n, r.begin());
+		}
+		auto R = h_->aggregate(pS->array, r.data());
+
+		result.resize(static_cast<unsigned>(n), 5);
+		for (size_t i = 0; i < n; ++i) {
+			result[5 * i + 0] = R[i].value;
+			result[5 * i + 1] = R[i].delta;
+			result[5 * i + 2] = R[i].gamma;
+			result[5 * i + 3] = R[i].vega;
+			result[5 * i + 4] = R[i].theta;
+		}
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_portfolio_ladder(
+	Function(XLL_FP, "xll_option_portfolio_ladder", "OPTION.PORTFOLIO.LADDER")
+	.Arguments({
+		Arg(XLL_HANDLEX, "h", "is a handle returned by \\OPTION.PORTFOLIO."),
+		Arg(XLL_FP, "S", "is an array of spots for each underlying."),
+		Arg(XLL_FP, "r", "is a rate or array of rates for each underlying."),
+		Arg(XLL_FP, "dS", "is an array of relative spot shocks."),
+		Arg(XLL_FP, "dsigma", "is an array of relative volatility shocks."),
+		})
+	.FunctionHelp("Return the change in portfolio value over a grid of spot and volatility shocks.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Row <code>i</code> and column <code>j</code> of the result is the change in value of
+the portfolio when every spot is multiplied by \(1 + dS_i\) and every volatility
+by \(1 + d\sigma_j\). Positions with the same expiration and volatility are revalued
+over all shocks together and each volatility shock shares the discount and cumulant.
+)")
+);
+_FPX* WINAPI xll_option_portfolio_ladder(HANDLEX h, const _FPX* pS, const _FPX* pr, const _FPX* pdS, const _FPX* pds)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		handle<bsm::portfolio> h_(h);
+		ensure(h_);
+		size_t n = h_->underlyings();
+		ensure(size(*pS) == n);
+		ensure(size(*pr) == 1 || size(*pr) == n);
+
+		std::vector<double> r(n, pr->array[0]);
+		if (size(*pr) == n) {
+			std::copy(pr->array, pr->array + n, r.begin());
+		}
+		auto P = h_->ladder(pS->array, r.data(), size(*pdS), pdS->array, size(*pds), pds->array);
+
+		result.resize(static_cast<unsigned>(size(*pdS)), static_cast<unsigned>(size(*pds)));
+		std::copy(P.begin(), P.end(), result.array());
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_portfolio_var(
+	Function(XLL_FP, "xll_option_portfolio_var", "OPTION.PORTFOLIO.VAR")
+	.Arguments({
+		Arg(XLL_HANDLEX, "h", "is a handle returned by \\OPTION.PORTFOLIO."),
+		Arg(XLL_FP, "S", "is an array of spots for each underlying."),
+		Arg(XLL_HANDLEX, "curve", "is a handle to a forward curve."),
+		Arg(XLL_FP, "dS", "is a matrix of relative spot shocks with one row per scenario and one column per underlying."),
+		Arg(XLL_FP, "dsigma", "is a matrix of relative volatility shocks with one row per scenario and one column per underlying."),
+		Arg(XLL_FP, "df", "is an array of parallel forward curve shifts for each scenario."),
+		Arg(XLL_DOUBLE, "_alpha", "is the optional confidence level. Default is 0.99."),
+		})
+	.FunctionHelp("Return value at risk and expected shortfall of a portfolio by full revaluation.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Revalue every position under each scenario and return a one row array of
+value at risk, the <code>alpha</code> quantile of losses, and expected shortfall,
+the mean of the largest <code>1 - alpha</code> fraction of losses.
+Rates for each expiration are the spot rates of the shifted curve.
+Value at risk uses the P<sup>2</sup> streaming quantile estimate.
+)")
+);
+_FPX* WINAPI xll_option_portfolio_var(HANDLEX h, const _FPX* pS, HANDLEX c, const _FPX* pdS, const _FPX* pds, const _FPX* pdf, double alpha)
+{
+#pragma XLLEXPORT
+	static FPX result(1, 2);
+
+	try {
+		handle<bsm::portfolio> h_(h);
+		ensure(h_);
+		handle<pwflat::curve<>> c_(c);
+		ensure(c_);
+		ensure(h_->sorted());
+		size_t nu = h_->underlyings();
+		size_t m = size(*pdf);
+		ensure(size(*pS) == nu);
+		ensure(size(*pdS) == m * nu);
+		ensure(size(*pds) == m * nu);
+		if (alpha == 0) {
+			alpha = 0.99;
+		}
+		ensure(0 < alpha && alpha < 1);
+
+		auto scenario = [=](size_t i, double* dS, double* dv, double& df) {
+			std::copy(pdS->array + i * nu, pdS->array + (i + 1) * nu, dS);
+			std::copy(pds->array + i * nu, pds->array + (i + 1) * nu, dv);
+			df = pdf->array[i];
+		};
+		auto r = bsm::full_revaluation(*h_, pS->array, *c_, m, scenario, alpha);
+
+		result[0] = r.var();
+		result[1] = r.es();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_proxy_(
+	Function(XLL_HANDLEX, "xll_option_proxy_", "\\OPTION.PROXY")
+	.Arguments({
+		Arg(XLL_DOUBLE, "k", "is the strike. Use negative strikes for puts."),
+		Arg(XLL_FP, "f", "is a two element array of the lowest and highest forward."),
+		Arg(XLL_FP, "s", "is a two element array of the lowest and highest vol."),
+		Arg(XLL_FP, "_n", "is an optional one or two element array of the number of nodes. Default is 16."),
+		Arg(XLL_HANDLEX, "_v", "is an optional handle to a variate. Default is normal."),
+		})
+	.Uncalced()
+	.FunctionHelp("Return a handle to a Chebyshev proxy of the forward option value.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Sample the forward option value on the product of Chebyshev nodes in
+forward and vol and store the coefficients of the interpolating polynomial.
+Use <code>OPTION.PROXY.VALUE</code> to evaluate the proxy and
+<code>OPTION.PROXY.ERROR</code> for an estimate of the interpolation error.
+)")
+);
+HANDLEX WINAPI xll_option_proxy_(double k, const _FPX* pf, const _FPX* ps, const _FPX* pn, HANDLEX v)
+{
+#pragma XLLEXPORT
+	HANDLEX h = INVALID_HANDLEX;
+
+	try {
+		ensure(size(*pf) == 2);
+		ensure(size(*ps) == 2);
+		ensure(size(*pn) <= 2);
+		size_t n0 = 16, n1 = 16;
+		if (pn->array[0] > 0) {
+			n0 = n1 = static_cast<size_t>(pn->array[0]);
+		}
+		if (size(*pn) == 2) {
+			n1 = static_cast<size_t>(pn->array[1]);
+		}
+		const variate::base& v_ = *pv(v);
+
+		handle<chebyshev::proxy<2>> h_(new chebyshev::proxy<2>({ n0, n1 },
+			{ pf->array[0], ps->array[0] }, { pf->array[1], ps->array[1] }, [&](const auto& x) {
+				return black::value(v_, x[0], x[1], k);
+			}));
+		ensure(h_);
+
+		h = h_.get();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return h;
+}
+
+AddIn xai_option_proxy_value(
+	Function(XLL_FP, "xll_option_proxy_value", "OPTION.PROXY.VALUE")
+	.Arguments({
+		Arg(XLL_HANDLEX, "h", "is a handle returned by \\OPTION.PROXY."),
+		Arg(XLL_FP, "f", "is an array of forwards."),
+		Arg(XLL_FP, "s", "is a vol or array of vols."),
+		})
+	.FunctionHelp("Return the Chebyshev proxy of the forward option value.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Forwards and vols outside the range of the proxy return <code>#NUM!</code>.
+)")
+);
+_FPX* WINAPI xll_option_proxy_value(HANDLEX h, const _FPX* pf, const _FPX* ps)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		handle<chebyshev::proxy<2>> h_(h);
+		ensure(h_);
+		size_t n = size(*pf);
+		ensure(size(*ps) == 1 || size(*ps) == n);
+
+		result.resize(pf->rows, pf->columns);
+		for (size_t i = 0; i < n; ++i) {
+			double s = ps->array[size(*ps) == 1 ? 0 : i];
+			result[i] = (*h_)({ pf->array[i], s });
+		}
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_proxy_error(
+	Function(XLL_DOUBLE, "xll_option_proxy_error", "OPTION.PROXY.ERROR")
+	.Arguments({
+		Arg(XLL_HANDLEX, "h", "is a handle returned by \\OPTION.PROXY."),
+		})
+	.FunctionHelp("Return an estimate of the Chebyshev proxy interpolation error.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Sum of the absolute values of the highest degree coefficients in either dimension.
+)")
+);
+double WINAPI xll_option_proxy_error(HANDLEX h)
+{
+#pragma XLLEXPORT
+	double result = XLL_NAN;
+
+	try {
+		handle<chebyshev::proxy<2>> h_(h);
+		ensure(h_);
+
+		result = h_->error();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return result;
+}
+
+AddIn xai_option_pde(
+	Function(XLL_FP, "xll_option_pde", "OPTION.PDE")
+	.Arguments({
+		Arg(XLL_DOUBLE, "S", "is the spot."),
+		Arg(XLL_DOUBLE, "sigma", "is the volatility."),
+		Arg(XLL_WORD, "option", "is the contract type from OPTION_*."),
+		Arg(XLL_FP, "k", "is a strike or array of strikes."),
+		Arg(XLL_DOUBLE, "t", "is the time in years to expiration."),
+		Arg(XLL_HANDLEX, "curve", "is a handle to a forward curve."),
+		Arg(XLL_BOOL, "_american", "is an optional boolean indicating early exercise. Default is FALSE."),
+		Arg(XLL_WORD, "_m", "is an optional number of space intervals. Default is 200."),
+		Arg(XLL_WORD, "_n", "is an optional number of time steps. Default is 100."),
+		})
+	.FunctionHelp("Return option values from a Crank-Nicolson finite difference solution.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Solve the Black-Scholes/Merton equation in log spot with Rannacher smoothing
+and rates from the forward curve. American exercise uses the Brennan-Schwartz algorithm.
+All strikes are valued from one solve with unit strike by homogeneity.
+)")
+);
+_FPX* WINAPI xll_option_pde(double S, double sigma, option::contract c, const _FPX* pk, double t, HANDLEX f,
+	BOOL american, unsigned m, unsigned n)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		handle<pwflat::curve<>> f_(f);
+		ensure(f_);
+		pde::crank_nicolson cn(m ? m : 200, n ? n : 100);
+
+		result.resize(pk->rows, pk->columns);
+		pde::value(cn, S, sigma, c, size(*pk), pk->array, t, *f_, american ? pde::AMERICAN : pde::EUROPEAN, result.array());
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_term_value(
+	Function(XLL_FP, "xll_option_term_value", "OPTION.TERM.VALUE")
+	.Arguments({
+		Arg(XLL_DOUBLE, "S", "is the spot."),
+		Arg(XLL_FP, "option", "is an array of contract types from OPTION_*."),
+		Arg(XLL_FP, "k", "is an array of strikes."),
+		Arg(XLL_FP, "t", "is an array of times in years to expiration."),
+		Arg(XLL_HANDLEX, "r", "is a handle to a forward rate curve."),
+		Arg(XLL_HANDLEX, "var", "is a handle to a curve of instantaneous variance."),
+		Arg(XLL_HANDLEX, "_v", "is an optional handle to a variate. Default is normal."),
+		})
+	.FunctionHelp("Return option values using rate and variance term structures.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+The discount to \(t\) is \(\exp(-\int_0^t r(u)\,du)\) and the vol is
+\(\sigma\sqrt{t} = (\int_0^t \sigma^2(u)\,du)^{1/2}\).
+Positions with the same expiration as the previous one share curve lookups
+so sort by expiration when pricing a book.
+)")
+);
+_FPX* WINAPI xll_option_term_value(double S, const _FPX* pc, const _FPX* pk, const _FPX* pt, HANDLEX r, HANDLEX var, HANDLEX v)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		handle<pwflat::curve<>> r_(r);
+		ensure(r_);
+		handle<pwflat::curve<>> var_(var);
+		ensure(var_);
+		size_t n = size(*pk);
+		ensure(size(*pc) == n);
+		ensure(size(*pt) == n);
+
+		std::vector<int> c(n);
+		for (size_t i = 0; i < n; ++i) {
+			c[i] = static_cast<int>(pc->array[i]);
+		}
+		result.resize(pk->rows, pk->columns);
+		bsm::value(*pv(v), *r_, *var_, S, n, c.data(), pk->array, pt->array, result.array());
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_svi_fit(
+	Function(XLL_FP, "xll_option_svi_fit", "OPTION.SVI.FIT")
+	.Arguments({
+		Arg(XLL_FP, "k", "is an array of log strikes log(K/F)."),
+		Arg(XLL_FP, "w", "is an array of total implied variances sigma^2 t."),
+		Arg(XLL_FP, "_p", "is an optional starting point a, b, rho, m, sigma, e.g., the previous fit."),
+		})
+	.FunctionHelp("Return raw SVI parameters a, b, rho, m, sigma and the root mean square error.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Fit \(w(k) = a + b(\rho(k - m) + \sqrt{(k - m)^2 + \sigma^2})\) using Levenberg-Marquardt.
+The optional starting point is used if it is a valid parameterization.
+)")
+);
+_FPX* WINAPI xll_option_svi_fit(const _FPX* pk, const _FPX* pw, const _FPX* pp)
+{
+#pragma XLLEXPORT
+	static FPX result(1, 6);
+
+	try {
+		size_t n = size(*pk);
+		ensure(size(*pw) == n);
+
+		svi::raw p{ 0, 0, 0, 0, 0 };
+		if (size(*pp) == 5) {
+			p = svi::raw{ pp->array[0], pp->array[1], pp->array[2], pp->array[3], pp->array[4] };
+		}
+		svi::result res = svi::fit(n, pk->array, pw->array, p);
+
+		result[0] = p.a;
+		result[1] = p.b;
+		result[2] = p.rho;
+		result[3] = p.m;
+		result[4] = p.sigma;
+		result[5] = res.converged ? res.rmse : XLL_NAN;
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_svi_value(
+	Function(XLL_FP, "xll_option_svi_value", "OPTION.SVI.VALUE")
+	.Arguments({
+		Arg(XLL_FP, "p", "is an array of raw SVI parameters a, b, rho, m, sigma."),
+		Arg(XLL_FP, "k", "is an array of log strikes."),
+		})
+	.FunctionHelp("Return raw SVI total implied variance at log strikes.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Total implied variance \(w(k) = a + b(\rho(k - m) + \sqrt{(k - m)^2 + \sigma^2})\).
+)")
+);
+_FPX* WINAPI xll_option_svi_value(const _FPX* pp, const _FPX* pk)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		ensure(size(*pp) >= 5);
+		svi::raw p{ pp->array[0], pp->array[1], pp->array[2], pp->array[3], pp->array[4] };
+
+		result.resize(pk->rows, pk->columns);
+		for (size_t i = 0; i < size(*pk); ++i) {
+			result[i] = p(pk->array[i]);
+		}
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_caplets(
+	Function(XLL_FP, "xll_option_caplets", "OPTION.CAPLETS")
+	.Arguments({
+		Arg(XLL_HANDLEX, "curve", "is a handle to a forward curve."),
+		Arg(XLL_FP, "t", "is an array of n + 1 increasing period dates in years."),
+		Arg(XLL_FP, "sigma", "is a vol or array of n caplet vols."),
+		Arg(XLL_WORD, "option", "is OPTION_CALL for caplets or OPTION_PUT for floorlets."),
+		Arg(XLL_DOUBLE, "k", "is the strike. Any strike for Bachelier, positive for Black."),
+		Arg(XLL_BOOL, "_bachelier", "is an optional boolean indicating normal vols. Default is FALSE."),
+		})
+	.FunctionHelp("Return the value of each caplet or floorlet in a strip.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Period \(i\) accrues from \(t_i\) to \(t_{i+1}\) and is fixed at \(t_i\).
+Discounts at all dates are computed in one sweep over the curve.
+)")
+);
+_FPX* WINAPI xll_option_caplets(HANDLEX c, const _FPX* pt, const _FPX* ps, contract o, double k, BOOL bachelier)
+{
+#pragma XLLEXPORT
+	static FPX result;
+
+	try {
+		handle<pwflat::curve<>> c_(c);
+		ensure(c_);
+		ensure(size(*pt) > 1);
+		size_t n = size(*pt) - 1;
+		ensure(size(*ps) == 1 || size(*ps) == n);
+		ensure(rates::strip::increasing(n, pt->array));
+		ensure(o == contract::PUT || o == contract::CALL);
+
+		std::vector<double> sigma(n, ps->array[0]);
+		if (size(*ps) == n) {
+			std::copy(ps->array, ps->array + n, sigma.begin());
+		}
+		rates::strip s(*c_, n, pt->array);
+
+		result.resize(static_cast<unsigned>(n), 1);
+		s.caplets(sigma.data(), o, k, result.array(), bachelier ? rates::BACHELIER : rates::BLACK);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
+AddIn xai_option_swaption(
+	Function(XLL_DOUBLE, "xll_option_swaption", "OPTION.SWAPTION")
+	.Arguments({
+		Arg(XLL_HANDLEX, "curve", "is a handle to a forward curve."),
+		Arg(XLL_FP, "t", "is an array of increasing swap dates in years starting at expiration."),
+		Arg(XLL_DOUBLE, "sigma", "is the swaption vol."),
+		Arg(XLL_WORD, "option", "is OPTION_CALL for payers or OPTION_PUT for receivers."),
+		Arg(XLL_DOUBLE, "k", "is the strike. Any strike for Bachelier, positive for Black."),
+		Arg(XLL_BOOL, "_bachelier", "is an optional boolean indicating normal vol. Default is FALSE."),
+		})
+	.FunctionHelp("Return the value of a payer or receiver swaption.")
+	.Category(CATEGORY)
+	.Documentation(R"(
+Value is the annuity times the Black or Bachelier value on the forward swap rate
+expiring at the first date.
+)")
+);
+double WINAPI xll_option_swaption(HANDLEX c, const _FPX* pt, double sigma, contract o, double k, BOOL bachelier)
+{
+#pragma XLLEXPORT
+	double result = XLL_NAN;
+
+	try {
+		handle<pwflat::curve<>> c_(c);
+		ensure(c_);
+		ensure(size(*pt) > 1);
+		size_t n = size(*pt) - 1;
+		ensure(rates::strip::increasing(n, pt->array));
+		ensure(o == contract::PUT || o == contract::CALL);
+		rates::strip s(*c_, n, pt->array);
+
+		result = s.swaption(0, n, sigma, o, k, bachelier ? rates::BACHELIER : rates::BLACK);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return result;
+}
+
 AddIn xai_option_variance(
 	Function(XLL_DOUBLE, "xll_option_variance", "OPTION.VARIANCE")
 	.Arguments({
@@ -1,5 +1,7 @@
 // xll_pwflat.cpp - Piecewise constant curves
-#include "fms_pwflat.h"
+#include <chrono>
+#include <random>
+#include "fms_pwflat_bootstrap.h"
 #include "xll_FRE6233.h"
 
 using namespace fms;
@@ -10,6 +12,11 @@ int fms_pwflat_value_test = pwflat::value_test();
 int fms_pwflat_integral_test = pwflat::integral_test();
 int fms_pwflat_discount_test = pwflat::discount_test();
 int fms_pwflat_spot_test = pwflat::spot_test();
+int fms_pwflat_gradient_test = pwflat::gradient_test();
+int fms_pwflat_batch_test = pwflat::batch_test();
+int fms_pwflat_eytzinger_test = pwflat::eytzinger_test();
+int fms_pwflat_curve_test = pwflat::curve<>::test();
+int fms_pwflat_bootstrap_test = pwflat::bootstrap_test();
 #endif // _DEBUG
 
 AddIn xai_pwflat_curve_(
@@ -32,6 +39,62 @@ HANDLEX WINAPI xll_pwflat_curve_(const _FPX* pt, const _FPX* pf, double _f)
 }
 
 
+AddIn xai_pwflat_curve_bootstrap_(
+	Function(XLL_HANDLEX, "xll_pwflat_curve_bootstrap_", "\\PWF.CURVE.BOOTSTRAP")
+	.Arguments({
+		Arg(XLL_FP, "deposits", "is a two column array of deposit times and simple rates."),
+		Arg(XLL_FP, "swaps", "is a two column array of swap maturities and par coupons."),
+		Arg(XLL_LONG, "_freq", "is the optional number of swap payments per year. Default is 2."),
+		})
+	.Uncalced()
+	.Category(CATEGORY)
+	.FunctionHelp("Return a handle to a curve that reprices deposits and swaps.")
+	.Documentation(R"(
+Fit one forward per instrument in order of maturity. Each step holds the
+existing curve fixed and solves for the forward from the last knot
+to the instrument maturity so the instrument reprices exactly.
+)")
+);
+HANDLEX WINAPI xll_pwflat_curve_bootstrap_(const _FPX* pd, const _FPX* ps, LONG freq)
+{
+#pragma XLLEXPORT
+	HANDLEX h = INVALID_HANDLEX;
+
+	try {
+		if (freq <= 0) {
+			freq = 2;
+		}
+
+		std::vector<pwflat::instrument<>> is;
+		if (pd->columns == 2) {
+			for (unsigned i = 0; i < pd->rows; ++i) {
+				ensure(pd->array[2 * i] > 0);
+				is.push_back(pwflat::deposit(pd->array[2 * i], pd->array[2 * i + 1]));
+			}
+		}
+		if (ps->columns == 2) {
+			for (unsigned i = 0; i < ps->rows; ++i) {
+				ensure(ps->array[2 * i] > 0);
+				is.push_back(pwflat::swap(ps->array[2 * i], ps->array[2 * i + 1], freq));
+			}
+		}
+		std::sort(is.begin(), is.end(), [](const auto& a, const auto& b) { return a.u.back() < b.u.back(); });
+
+		handle<pwflat::curve<>> h_(new pwflat::curve<>());
+		ensure(h_);
+		// instruments must have increasing maturities and reprice
+		ensure(pwflat::bootstrap(*h_, is.size(), is.data()) == is.size());
+		h_->extrapolate(h_->forward(h_->back().first));
+
+		h = h_.get();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+
+	return h;
+}
+
 AddIn xai_pwflat_curve_value(
 	Function(XLL_DOUBLE, "xll_pwflat_curve_value", "PWF.CURVE.FORWARD")
 	.Arguments({
@@ -49,6 +112,146 @@ double WINAPI xll_pwflat_curve_value(HANDLEX h, double u)
 	return h_->forward(u);
 }
 
+AddIn xai_pwflat_curve_discount(
+	Function(XLL_FP, "xll_pwflat_curve_discount", "PWF.CURVE.DISCOUNT")
+	.Arguments({
+		Arg(XLL_HANDLEX, "curve", "is a handle to a curve."),
+		Arg(XLL_FP, "u", "is a sorted array of times at which to calculate the discount."),
+		})
+	.Category(CATEGORY)
+	.FunctionHelp("Return discount factors of a piecewise constant forward curve.")
+	.Documentation(R"(
+Discount is \(D(u) = \exp(-\int_0^u f(t)\,dt)\).
+Times must be sorted so all discounts are computed in one pass over the curve.
+)")
+);
+_FPX* WINAPI xll_pwflat_curve_discount(HANDLEX h, const _FPX* pu)
+{
+#pragma XLLEXPORT
+	static FPX D;
+
+	try {
+		handle<pwflat::curve<>> h_(h);
+		ensure(h_);
+		ensure(std::is_sorted(pu->array, pu->array + size(*pu)));
+
+		D.resize(pu->rows, pu->columns);
+		h_->discount(size(*pu), pu->array, D.array());
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return D.get();
+}
+
+AddIn xai_pwflat_curve_gradient(
+	Function(XLL_FP, "xll_pwflat_curve_gradient", "PWF.CURVE.GRADIENT")
+	.Arguments({
+		Arg(XLL_HANDLEX, "curve", "is a handle to a curve."),
+		Arg(XLL_FP, "u", "is a sorted array of cash flow times."),
+		Arg(XLL_FP, "c", "is an array of cash flow amounts."),
+		})
+	.Category(CATEGORY)
+	.FunctionHelp("Return derivatives of the present value of cash flows with respect to each forward.")
+	.Documentation(R"(
+Present value is \(P = \sum_j c_j D(u_j)\). Returns a one row array of
+\(\partial P/\partial f_i\) for each forward of the curve followed by the
+extrapolated forward. All entries are computed in one pass over the curve
+and cash flows.
+)")
+);
+_FPX* WINAPI xll_pwflat_curve_gradient(HANDLEX h, const _FPX* pu, const _FPX* pc)
+{
+#pragma XLLEXPORT
+	static FPX dP;
+
+	try {
+		handle<pwflat::curve<>> h_(h);
+		ensure(h_);
+		ensure(size(*pu) == size(*pc));
+		ensure(std::is_sorted(pu->array, pu->array + size(*pu)));
+
+		dP.resize(1, static_cast<unsigned>(h_->size() + 1));
+		h_->present_value(size(*pu), pu->array, pc->array, dP.array());
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return dP.get();
+}
+
+AddIn xai_pwflat_search_benchmark(
+	Function(XLL_FP, "xll_pwflat_search_benchmark", "PWF.SEARCH.BENCHMARK")
+	.Arguments({
+		Arg(XLL_LONG, "n", "is the number of knots."),
+		Arg(XLL_LONG, "_m", "is the optional number of lookups. Default is 1000000."),
+		})
+	.Uncalced()
+	.Category(CATEGORY)
+	.FunctionHelp("Return nanoseconds per forward lookup using binary search and Eytzinger layout.")
+	.Documentation(R"(
+Time <code>PWF.CURVE.FORWARD</code> at uniformly distributed times on a curve with
+<code>n</code> daily knots. Returns a one row array of nanoseconds per lookup
+using <code>std::lower_bound</code> and the Eytzinger layout.
+)")
+);
+_FPX* WINAPI xll_pwflat_search_benchmark(LONG n, LONG m)
+{
+#pragma XLLEXPORT
+	static FPX result(1, 2);
+
+	try {
+		ensure(n > 0);
+		if (m <= 0) {
+			m = 1000000;
+		}
+
+		std::vector<double> t(n), f(n);
+		for (LONG i = 0; i < n; ++i) {
+			t[i] = (i + 1) / 365.;
+			f[i] = 0.01 + 1e-6 * i;
+		}
+		pwflat::curve<> c(n, t.data(), f.data(), f.back());
+		pwflat::curve<> e(c);
+		e.search(true);
+
+		std::default_random_engine dre;
+		std::uniform_real_distribution<double> U(0, t.back());
+		std::vector<double> u(m);
+		for (auto& ui : u) {
+			ui = U(dre);
+		}
+
+		double sc = 0, se = 0;
+		auto t0 = std::chrono::steady_clock::now();
+		for (double ui : u) {
+			sc += c.forward(ui);
+		}
+		auto t1 = std::chrono::steady_clock::now();
+		for (double ui : u) {
+			se += e.forward(ui);
+		}
+		auto t2 = std::chrono::steady_clock::now();
+		ensure(sc == se);
+
+		result[0] = std::chrono::duration<double, std::nano>(t1 - t0).count() / m;
+		result[1] = std::chrono::duration<double, std::nano>(t2 - t1).count() / m;
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+
+		return nullptr;
+	}
+
+	return result.get();
+}
+
 AddIn xai_pwflat_value(
 	Function(XLL_DOUBLE, "xll_pwflat_value", "PWF.VALUE")
 	.Arguments({
@@ -73,5 +73,39 @@ double WINAPI xll_variate_cumulant(HANDLEX v, double s, WORD ns)
 		XLL_ERROR(__FUNCTION__ ": unknown exception");
 	}
 
+	return result;
+}
+
+AddIn xai_variate_quantile(
+	Function(XLL_DOUBLE, "xll_variate_quantile", "VARIATE.QUANTILE")
+	.Arguments({
+		Arg(XLL_HANDLEX, "model", "is a handle to a variate model."),
+		Arg(XLL_DOUBLE, "p", "is the probability."),
+		Arg(XLL_DOUBLE, "s", "is the Esscher parameter."),
+		})
+		.Category(CATEGORY)
+	.FunctionHelp("Compute the quantile of the Esscher transform of a variate.")
+	.Documentation(R"(
+Return \(x\) with \(P^s(X \le x) = p\).
+)")
+);
+double WINAPI xll_variate_quantile(HANDLEX v, double p, double s)
+{
+#pragma XLLEXPORT
+	double result = XLL_NAN;
+
+	try {
+		handle<base> v_(v);
+		ensure(v_);
+
+		result = v_->quantile(p, s);
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+	catch (...) {
+		XLL_ERROR(__FUNCTION__ ": unknown exception");
+	}
+
 	return result;
 }
\ No newline at end of file
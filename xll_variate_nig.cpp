@@ -0,0 +1,47 @@
+// xll_variate_nig.cpp - Normal inverse Gaussian distribution
+#include "fms_variate_nig.h"
+#include "xll_FRE6233.h"
+
+using namespace xll;
+using namespace fms::variate;
+
+AddIn xai_variate_nig(
+	Function(XLL_HANDLEX, "xll_variate_nig", "\\VARIATE.NIG")
+	.Arguments({
+		Arg(XLL_DOUBLE, "alpha", "is the tail heaviness."),
+		Arg(XLL_DOUBLE, "beta", "is the asymmetry."),
+		Arg(XLL_DOUBLE, "_delta", "is the optional scale."),
+		Arg(XLL_DOUBLE, "_mu", "is the optional location."),
+		})
+	.Uncalced()
+	.Category(CATEGORY)
+	.FunctionHelp("Return a handle to a normal inverse Gaussian model.")
+	.Documentation(R"(
+The normal inverse Gaussian random variate has density
+\(\alpha\delta K_1(\alpha q(x))/(\pi q(x)) e^{\delta\gamma + \beta(x - \mu)}\)
+where \(q(x) = \sqrt{\delta^2 + (x - \mu)^2}\) and \(\gamma = \sqrt{\alpha^2 - \beta^2}\).
+If <code>delta</code> is 0 then \(\delta\) and \(\mu\) are chosen so the variate has mean 0 and variance 1.
+)")
+);
+HANDLEX WINAPI xll_variate_nig(double alpha, double beta, double delta, double mu)
+{
+#pragma XLLEXPORT
+	HANDLEX result = INVALID_HANDLEX;
+
+	try {
+		ensure(alpha > fabs(beta));
+		ensure(delta >= 0);
+
+		handle<base> h(delta == 0 ? new nig(alpha, beta) : new nig(alpha, beta, delta, mu));
+
+		result = h.get();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+	catch (...) {
+		XLL_ERROR(__FUNCTION__ ": unknown exception");
+	}
+
+	return result;
+}
@@ -0,0 +1,47 @@
+// xll_variate_student.cpp - Student t distribution
+#include "fms_variate_student.h"
+#include "xll_FRE6233.h"
+
+using namespace xll;
+using namespace fms::variate;
+
+AddIn xai_variate_student(
+	Function(XLL_HANDLEX, "xll_variate_student", "\\VARIATE.STUDENT")
+	.Arguments({
+		Arg(XLL_DOUBLE, "nu", "is the degrees of freedom."),
+		Arg(XLL_DOUBLE, "_mu", "is the optional location."),
+		Arg(XLL_DOUBLE, "_sigma", "is the optional scale."),
+		})
+	.Uncalced()
+	.Category(CATEGORY)
+	.FunctionHelp("Return a handle to a Student t model.")
+	.Documentation(R"(
+The Student t random variate is \(\mu + \sigma T\) where \(T\) has density proportional to
+\((1 + t^2/\nu)^{-(\nu + 1)/2}\).
+If <code>sigma</code> is 0 then the variate has mean 0 and variance 1.
+The Esscher transform only exists for \(s = 0\).
+)")
+);
+HANDLEX WINAPI xll_variate_student(double nu, double mu, double sigma)
+{
+#pragma XLLEXPORT
+	HANDLEX result = INVALID_HANDLEX;
+
+	try {
+		ensure(nu > 0);
+		ensure(sigma >= 0);
+		ensure(sigma != 0 || nu > 2);
+
+		handle<base> h(sigma == 0 ? new student(nu) : new student(nu, mu, sigma));
+
+		result = h.get();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+	catch (...) {
+		XLL_ERROR(__FUNCTION__ ": unknown exception");
+	}
+
+	return result;
+}
@@ -0,0 +1,48 @@
+// xll_variate_variance_gamma.cpp - Variance gamma distribution
+#include "fms_variate_variance_gamma.h"
+#include "xll_FRE6233.h"
+
+using namespace xll;
+using namespace fms::variate;
+
+AddIn xai_variate_variance_gamma(
+	Function(XLL_HANDLEX, "xll_variate_variance_gamma", "\\VARIATE.VARIANCE_GAMMA")
+	.Arguments({
+		Arg(XLL_DOUBLE, "nu", "is the variance of the gamma time change."),
+		Arg(XLL_DOUBLE, "theta", "is the drift of the time changed Brownian motion."),
+		Arg(XLL_DOUBLE, "_sigma", "is the optional volatility of the time changed Brownian motion."),
+		Arg(XLL_DOUBLE, "_mu", "is the optional location."),
+		})
+	.Uncalced()
+	.Category(CATEGORY)
+	.FunctionHelp("Return a handle to a variance gamma model.")
+	.Documentation(R"(
+The variance gamma random variate is \(\mu + \theta G + \sigma\sqrt{G} Z\) where
+\(G\) is gamma distributed with mean 1 and variance \(\nu\) and \(Z\) is
+independent standard normal.
+If <code>sigma</code> is 0 then \(\sigma\) and \(\mu\) are chosen so the variate has mean 0 and variance 1.
+)")
+);
+HANDLEX WINAPI xll_variate_variance_gamma(double nu, double theta, double sigma, double mu)
+{
+#pragma XLLEXPORT
+	HANDLEX result = INVALID_HANDLEX;
+
+	try {
+		ensure(nu > 0);
+		ensure(sigma >= 0);
+		ensure(sigma != 0 || theta * theta * nu < 1);
+
+		handle<base> h(sigma == 0 ? new variance_gamma(nu, theta) : new variance_gamma(sigma, nu, theta, mu));
+
+		result = h.get();
+	}
+	catch (const std::exception& ex) {
+		XLL_ERROR(ex.what());
+	}
+	catch (...) {
+		XLL_ERROR(__FUNCTION__ ": unknown exception");
+	}
+
+	return result;
+}